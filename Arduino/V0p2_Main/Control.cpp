@@ -22,13 +22,28 @@ Author(s) / Copyright (s): Damon Hart-Davis 2013--2017
  */
 
 #include "V0p2_Main.h"
-#if defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT) || defined(ENABLE_SECURE_RADIO_BEACON)
+#if defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT) || defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_ENTROPY_POOL)
 #include <OTAESGCM.h>
 #endif
+#if defined(TEMP_SENSOR_I2C_ASYNC)
+#include <Wire.h> // Arduino I2C library.
+#endif
+#if defined(ENABLE_DS18B20_BUS)
+#include <util/crc16.h>
+#endif
 
 #ifdef ENABLE_BOILER_HUB
 // True if boiler should be on.
 static bool isBoilerOn();
+// Number of valves recently heard from by the hub, and number of those currently calling for heat.
+static uint8_t hubDemandValves(bool callingOnly);
+// Aggregate demand: sum of %-open of valves currently calling for heat, capped at 255.
+static uint8_t hubDemandAggregatePC();
+// Boiler cycles started, and % of minutes with boiler on, over the last complete hour.
+static uint8_t boilerCyclesPerHour();
+static uint8_t boilerDutyPC();
+// Minutes currently added to minimum boiler on and off times to curb short-cycling.
+static uint8_t boilerCycleExtraM();
 #endif
 
 #ifndef getMinBoilerOnMinutes
@@ -48,7 +63,14 @@ static OTV0P2BASE::EEPROMByHourByteStats ebhs;
   typedef bool(*setbackLockout_t)();
 #if defined(ENABLE_SETBACK_LOCKOUT_COUNTDOWN) && defined(ARDUINO_ARCH_AVR)
   // If allowing setback lockout, eg for testing, then inject suitable lambda.
+#if defined(ENABLE_MOULD_RISK_MODE)
+  static bool setbackLockout() { return((0 != OTRadValve::getSetbackLockout()) || isMouldRisk()); }
+#else
   static bool setbackLockout() { return(0 != OTRadValve::getSetbackLockout()); }
+#endif // defined(ENABLE_MOULD_RISK_MODE)
+#elif defined(ENABLE_MOULD_RISK_MODE)
+  // Lock out setbacks while the room is at risk of mould.
+  static bool setbackLockout() { return(isMouldRisk()); }
 #else
   static constexpr setbackLockout_t setbackLockout = NULL;
 #endif
@@ -88,8 +110,285 @@ OTRadValve::ModelledRadValve NominalRadValve(
     100
   #endif
   );
+// Room temperature trend, updated after each fresh reading.
+TemperatureTrendC16 tempTrendC16;
+// Minutes since tempTrendC16 was last given a fresh reading.
+static uint8_t tempTrendM;
 #endif // ENABLE_MODELLED_RAD_VALVE
 
+#if defined(ENABLE_SIMULATED_ROOM)
+// Simulated room parameters; time constants are in minutes.
+#ifndef SIM_OUTSIDE_TEMP_C
+#define SIM_OUTSIDE_TEMP_C 5 // Outside temperature.
+#endif
+#ifndef SIM_START_TEMP_C
+#define SIM_START_TEMP_C 16 // Room and radiator temperature at power-up.
+#endif
+#ifndef SIM_FLOW_TEMP_C
+#define SIM_FLOW_TEMP_C 60 // Boiler flow temperature, assumed on whenever the valve is open at all.
+#endif
+#ifndef SIM_RAD_FILL_M
+#define SIM_RAD_FILL_M 8 // Radiator warm-up towards flow temperature with the valve fully open.
+#endif
+#ifndef SIM_RAD_TO_ROOM_M
+#define SIM_RAD_TO_ROOM_M 20 // Radiator cooling into the room.
+#endif
+#ifndef SIM_ROOM_MASS_RATIO
+#define SIM_ROOM_MASS_RATIO 20 // Room thermal mass relative to the radiator.
+#endif
+#ifndef SIM_ROOM_LOSS_M
+#define SIM_ROOM_LOSS_M 1200 // Room loss to outside.
+#endif
+SimulatedRoomTemperatureC16::SimulatedRoomTemperatureC16()
+  : roomC4096(SIM_START_TEMP_C * 4096L), radC4096(SIM_START_TEMP_C * 4096L)
+  { value = SIM_START_TEMP_C * 16; }
+// Closed-loop performance of the controller against the simulated room, over the current hour.
+// Sum of absolute error between sensed and target temperature (C16), and of valve % open, per minute.
+static uint16_t simComfortErrSumC16;
+static uint16_t simValvePCSum;
+static uint8_t simMinutes;
+// Mean absolute comfort error (C16) and mean valve % open (energy proxy) over the last complete hour.
+static uint8_t simComfortErrC16;
+static uint8_t simValvePC;
+int16_t SimulatedRoomTemperatureC16::read()
+  {
+  const uint8_t valvePC = NominalRadValve.get();
+  // Radiator fills from the boiler in proportion to valve opening, and empties into the room.
+  if(0 != valvePC) { radC4096 += ((SIM_FLOW_TEMP_C * 4096L - radC4096) * valvePC) / (100L * SIM_RAD_FILL_M); }
+  const int32_t toRoom = (radC4096 - roomC4096) / SIM_RAD_TO_ROOM_M;
+  radC4096 -= toRoom;
+  roomC4096 += toRoom / SIM_ROOM_MASS_RATIO;
+  // Room leaks to outside.
+  roomC4096 -= (roomC4096 - SIM_OUTSIDE_TEMP_C * 4096L) / SIM_ROOM_LOSS_M;
+  // Quantise as a real sensor would, with +/- 1 LSB of jitter some of the time.
+  const uint8_t r = OTV0P2BASE::randRNG8();
+  value = (int16_t)(roomC4096 >> 8) + ((1 == (r & 3)) ? 1 : ((2 == (r & 3)) ? -1 : 0));
+  // Track comfort error and energy proxy, summarised hourly.
+  const int16_t err = value - (int16_t)(NominalRadValve.targetTemperatureSubSensor.get() << 4);
+  simComfortErrSumC16 += (uint16_t)OTV0P2BASE::fnmin(abs(err), 255);
+  simValvePCSum += valvePC;
+  if(++simMinutes >= 60)
+    {
+    simComfortErrC16 = (uint8_t)(simComfortErrSumC16 / simMinutes);
+    simValvePC = (uint8_t)(simValvePCSum / simMinutes);
+    simComfortErrSumC16 = 0;
+    simValvePCSum = 0;
+    simMinutes = 0;
+    }
+  return(value);
+  }
+#endif // defined(ENABLE_SIMULATED_ROOM)
+
+#if defined(TEMP_SENSOR_I2C_ASYNC)
+bool AsyncRoomTemperatureC16Base::startConversion()
+  {
+  const bool neededPowerUp = OTV0P2BASE::powerUpTWIIfDisabled();
+  started = startI2C();
+  // The device converts on its own, so TWI can be powered down meanwhile.
+  if(neededPowerUp) { OTV0P2BASE::powerDownTWI(); }
+  return(started);
+  }
+int16_t AsyncRoomTemperatureC16Base::read()
+  {
+  if(!started && !startConversion()) { return(DEFAULT_INVALID_TEMP); }
+  started = false;
+  const bool neededPowerUp = OTV0P2BASE::powerUpTWIIfDisabled();
+  const int16_t oldValue = value;
+  bool ok = fetchI2C();
+  // If only just started then wait long enough for either device's conversion (22ms or 26ms).
+  if(!ok) { OTV0P2BASE::nap(WDTO_30MS); ok = fetchI2C(); }
+  if(neededPowerUp) { OTV0P2BASE::powerDownTWI(); }
+  if(!ok) { return(DEFAULT_INVALID_TEMP); }
+  // Capture entropy if value has changed; claim none as may be forced by Eve.
+  if((uint8_t)value != (uint8_t)oldValue) { OTV0P2BASE::addEntropyToPool((uint8_t)value, 0); }
+  return(value);
+  }
+#if defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
+static constexpr uint8_t SHT21_I2C_ADDR = 0x40;
+static constexpr uint8_t SHT21_I2C_CMD_TEMP_NOHOLD = 0xf3;
+static constexpr uint8_t SHT21_I2C_CMD_USERREG_W = 0xe6;
+static constexpr uint8_t SHT21_I2C_CMD_USERREG_R = 0xe7;
+bool AsyncRoomTemperatureC16_SHT21::startI2C()
+  {
+  if(!initialised)
+    {
+    // Select 12-bit temperature (1/16C) and 8-bit RH, preserving the reserved bits.
+    Wire.beginTransmission(SHT21_I2C_ADDR);
+    Wire.write((byte) SHT21_I2C_CMD_USERREG_R);
+    if(Wire.endTransmission() || (1 != Wire.requestFrom(SHT21_I2C_ADDR, (uint8_t)1))) { return(false); }
+    const uint8_t newUR = (Wire.read() & 0x38) | 3;
+    Wire.beginTransmission(SHT21_I2C_ADDR);
+    Wire.write((byte) SHT21_I2C_CMD_USERREG_W);
+    Wire.write((byte) newUR);
+    if(Wire.endTransmission()) { return(false); }
+    initialised = true;
+    }
+  Wire.beginTransmission(SHT21_I2C_ADDR);
+  Wire.write((byte) SHT21_I2C_CMD_TEMP_NOHOLD);
+  return(0 == Wire.endTransmission());
+  }
+bool AsyncRoomTemperatureC16_SHT21::fetchI2C()
+  {
+  // In no-hold mode the device does not acknowledge a read until the conversion is complete.
+  if(3 != Wire.requestFrom(SHT21_I2C_ADDR, (uint8_t)3)) { return(false); }
+  uint16_t rawTemp = (Wire.read() << 8);
+  rawTemp |= (Wire.read() & 0xfc); // Clear status ls bits.
+  Wire.read(); // Discard CRC.
+  // Nominal formula: C = -46.85 + ((175.72*raw) / (1L << 16));
+  value = -750 + ((5623L * rawTemp) >> 17);
+  return(true);
+  }
+#else
+static constexpr uint8_t TMP112_I2C_ADDR = 72;
+static constexpr uint8_t TMP112_REG_TEMP = 0; // Temperature register.
+static constexpr uint8_t TMP112_REG_CTRL = 1; // Control register.
+static constexpr uint8_t TMP112_CTRL_B1 = 0x31; // 12-bit resolution and shutdown mode (SD).
+static constexpr uint8_t TMP112_CTRL_B1_OS = 0x80; // One-shot flag.
+bool AsyncRoomTemperatureC16_TMP112::startI2C()
+  {
+  Wire.beginTransmission(TMP112_I2C_ADDR);
+  Wire.write((byte) TMP112_REG_CTRL);
+  Wire.write((byte) TMP112_CTRL_B1); // Clear OS bit.
+  Wire.endTransmission();
+  Wire.beginTransmission(TMP112_I2C_ADDR);
+  Wire.write((byte) TMP112_REG_CTRL);
+  Wire.write((byte) (TMP112_CTRL_B1 | TMP112_CTRL_B1_OS)); // Start one-shot conversion.
+  return(0 == Wire.endTransmission());
+  }
+bool AsyncRoomTemperatureC16_TMP112::fetchI2C()
+  {
+  // OS reads back as set once the one-shot conversion is complete.
+  Wire.beginTransmission(TMP112_I2C_ADDR);
+  Wire.write((byte) TMP112_REG_CTRL);
+  if(Wire.endTransmission() || (1 != Wire.requestFrom(TMP112_I2C_ADDR, (uint8_t)1))) { return(false); }
+  if(!(Wire.read() & TMP112_CTRL_B1_OS)) { return(false); }
+  Wire.beginTransmission(TMP112_I2C_ADDR);
+  Wire.write((byte) TMP112_REG_TEMP);
+  if(Wire.endTransmission() || (2 != Wire.requestFrom(TMP112_I2C_ADDR, (uint8_t)2))) { return(false); }
+  const uint8_t b1 = Wire.read(); // MSByte, signed whole degrees C.
+  const uint8_t b2 = Wire.read();
+  // 12-bit value (not extended mode), sign-extended for sub-zero temperatures.
+  value = (int16_t)((b1 << 4) | (b2 >> 4) | ((b1 & 0x80) ? 0xf000 : 0));
+  return(true);
+  }
+#endif
+#endif // defined(TEMP_SENSOR_I2C_ASYNC)
+
+#if defined(ENABLE_DS18B20_BUS)
+static constexpr uint8_t DS18B20_FAMILY_CODE = 0x28;
+static constexpr uint8_t DS18B20_CMD_CONVERT_T = 0x44;
+static constexpr uint8_t DS18B20_CMD_WRITE_SCRATCHPAD = 0x4e;
+static constexpr uint8_t DS18B20_CMD_READ_SCRATCHPAD = 0xbe;
+// Dallas/Maxim CRC8 of the given bytes; 0 if the last byte is a correct CRC of the others.
+static uint8_t ds18b20CRC(const uint8_t *buf, uint8_t len)
+  {
+  uint8_t crc = 0;
+  while(len-- > 0) { crc = _crc_ibutton_update(crc, *buf++); }
+  return(crc);
+  }
+bool DS18B20Bus::init()
+  {
+  initialised = true;
+  searchWaitM = DS18B20_BUS_SEARCH_RETRY_M;
+  probes = 0;
+  uint8_t addr[8];
+  ow.reset_search();
+  while((probes < DS18B20_BUS_MAX_PROBES) && ow.search(addr))
+    {
+    if((DS18B20_FAMILY_CODE != addr[0]) || (0 != ds18b20CRC(addr, 8))) { continue; }
+    memcpy(rom[probes], addr, 8);
+    values[probes++] = OTV0P2BASE::TemperatureC16Base::DEFAULT_INVALID_TEMP;
+    }
+  if((0 == probes) || !ow.reset()) { return(false); }
+  // Set precision on all probes at once: TH and TL (unused alarm limits) then configuration.
+  ow.skip();
+  ow.write(DS18B20_CMD_WRITE_SCRATCHPAD);
+  ow.write(0);
+  ow.write(0);
+  ow.write((uint8_t)(((precision - 9) << 5) | 0x1f));
+  return(true);
+  }
+bool DS18B20Bus::startConversion()
+  {
+  // Search on first use, and again from time to time while nothing has been found, eg probes fitted later.
+  if(!initialised || ((0 == probes) && (0 == --searchWaitM))) { init(); }
+  if((0 == probes) || !ow.reset()) { return(false); }
+  // Skip ROM addresses every device on the bus.
+  ow.skip();
+  ow.write(DS18B20_CMD_CONVERT_T);
+  converting = true;
+  return(true);
+  }
+bool DS18B20Bus::collect()
+  {
+  if(!converting)
+    {
+    if(!startConversion()) { return(false); }
+    // Probes hold the bus low while converting (up to 750ms at 12 bits).
+    while(!ow.read_bit())
+      {
+      if(OTV0P2BASE::getSubCycleTime() >= OTV0P2BASE::GSCT_MAX - 8) { converting = false; return(false); }
+      OTV0P2BASE::nap(WDTO_15MS);
+      }
+    }
+  converting = false;
+  // Low bits undefined at reduced precision.
+  const int16_t mask = (int16_t)~((1 << (12 - precision)) - 1);
+  bool allOK = true;
+  for(uint8_t i = 0; i < probes; ++i)
+    {
+    uint8_t sp[9];
+    if(!ow.reset()) { values[i] = OTV0P2BASE::TemperatureC16Base::DEFAULT_INVALID_TEMP; allOK = false; continue; }
+    ow.select(rom[i]);
+    ow.write(DS18B20_CMD_READ_SCRATCHPAD);
+    for(uint8_t j = 0; j < sizeof(sp); ++j) { sp[j] = ow.read(); }
+    // Reject bad CRCs, and an all-zero scratchpad (eg shorted bus) by the fixed configuration bits.
+    if((0 != ds18b20CRC(sp, sizeof(sp))) || (0x1f != (sp[4] & 0x9f)))
+      { values[i] = OTV0P2BASE::TemperatureC16Base::DEFAULT_INVALID_TEMP; allOK = false; continue; }
+    values[i] = (int16_t)((sp[1] << 8) | sp[0]) & mask;
+    }
+  return(allOK);
+  }
+#if defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+int16_t DS18B20BusTemperatureC16::read()
+  {
+  ds18b20Bus.collect();
+  value = ds18b20Bus.get(0);
+  return(value);
+  }
+#endif
+#endif // defined(ENABLE_DS18B20_BUS)
+
+
+#ifdef ENABLE_RADIO_SECONDARY_MODULE
+// Worst-case duration of a secondary radio poll() in sub-cycle ticks since the last reset; 0xff if a minor cycle or more.
+// Reset hourly so that the value reported in stats is the peak over (about) the last hour.
+static uint8_t secondaryRadioPollMaxTicks;
+// A secondary radio poll() taking more than this many sub-cycle ticks is treated as having blocked.
+#ifndef SECONDARY_RADIO_SLOW_POLL_TICKS
+#define SECONDARY_RADIO_SLOW_POLL_TICKS 4 // ~31ms.
+#endif
+// Seconds value of the minor cycle in which a poll() last blocked; 0xff if none.
+static uint8_t secondaryRadioSlowPollS = 0xff;
+// Poll the secondary radio, recording the worst-case poll() duration observed.
+// Called from pollIO() as often as the primary radio, so that the driver's state machine keeps moving,
+// and at the start of each minor cycle.
+// Skipped in the last quarter of the minor cycle to leave time for other work before the next,
+// and for the rest of any minor cycle in which a poll() has already blocked
+// (eg on AT command exchanges with a SIM900),
+// so a slow modem costs at most about one long poll per cycle, usually made early.
+static void pollSecondaryRadio()
+  {
+  const uint8_t sctStart = OTV0P2BASE::getSubCycleTime();
+  if(sctStart >= (OTV0P2BASE::GSCT_MAX - (OTV0P2BASE::GSCT_MAX/4))) { return; }
+  const uint8_t sStart = OTV0P2BASE::getSecondsLT();
+  if(sStart == secondaryRadioSlowPollS) { return; }
+  SecondaryRadio.poll();
+  const uint8_t ticks = (sStart != OTV0P2BASE::getSecondsLT()) ? 0xff : (OTV0P2BASE::getSubCycleTime() - sctStart);
+  if(ticks > secondaryRadioPollMaxTicks) { secondaryRadioPollMaxTicks = ticks; }
+  if(ticks > SECONDARY_RADIO_SLOW_POLL_TICKS) { secondaryRadioSlowPollS = sStart; }
+  }
+#endif // ENABLE_RADIO_SECONDARY_MODULE
 
 // Call this to do an I/O poll if needed; returns true if something useful definitely happened.
 // This call should typically take << 1ms at 1MHz CPU.
@@ -114,17 +413,613 @@ bool pollIO(const bool force)
     // before getting an RX overrun or dropped frame.
     PrimaryRadio.poll();
   #ifdef ENABLE_RADIO_SECONDARY_MODULE
-    SecondaryRadio.poll();
+    // Gated, since its driver may block for a long time, eg waiting for a SIM900 modem.
+    pollSecondaryRadio();
   #endif
     }
 #endif
   return(false);
   }
 
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+// Spreading factor assumed for time-on-air estimates; [7,12].
+// Defaults to the slowest (SF12) so that the budget is never under-estimated.
+#ifndef RN2483_AIRTIME_SF
+#define RN2483_AIRTIME_SF 12
+#endif
+static_assert((RN2483_AIRTIME_SF >= 7) && (RN2483_AIRTIME_SF <= 12), "bad RN2483_AIRTIME_SF");
+// LoRaWAN overhead bytes per frame (MHDR, FHDR, FPort, MIC).
+static constexpr uint8_t LORAWAN_OVERHEAD_BYTES = 13;
+// Duty-cycle budget held as a token bucket in ms of airtime:
+// refilled at 1% of elapsed time (20ms per 2s minor cycle), capped at one hour's worth (36s).
+static constexpr uint16_t LORA_AIRTIME_REFILL_MS_PER_CYCLE = 20;
+static constexpr uint16_t LORA_AIRTIME_MAX_MS = 36000U;
+// Part of the budget held back for high-priority frames.
+static constexpr uint16_t LORA_AIRTIME_RESERVE_MS = LORA_AIRTIME_MAX_MS / 4;
+// Airtime available at boot (ms): the high-priority reserve plus room for a few normal frames,
+// so that routine stats can go soon after a restart
+// while frequent restarts still cannot much exceed the duty cycle.
+static constexpr uint16_t LORA_AIRTIME_INITIAL_MS = LORA_AIRTIME_RESERVE_MS + (LORA_AIRTIME_MAX_MS / 8);
+// Airtime currently available (ms).
+static uint16_t loRaAirtimeMs = LORA_AIRTIME_INITIAL_MS;
+
+// Estimate LoRa time on air (ms) for a frame with the given application payload size.
+// Uses the Semtech formula for 125kHz bandwidth, coding rate 4/5, explicit header, CRC on,
+// 8 preamble symbols, with low data rate optimisation at SF11 and SF12.
+static uint16_t loRaTimeOnAirMs(const uint8_t payloadBytes)
+  {
+  constexpr uint8_t sf = RN2483_AIRTIME_SF;
+  constexpr uint8_t de = (sf >= 11) ? 1 : 0;
+  constexpr uint32_t tSymUs = (uint32_t(1) << sf) * 8; // 2^SF / 125kHz.
+  const int16_t pl = int16_t(payloadBytes) + LORAWAN_OVERHEAD_BYTES;
+  const int16_t num = (8 * pl) - (4 * sf) + 28 + 16;
+  const int16_t den = 4 * (sf - (2 * de));
+  const int16_t nPayload = 8 + ((num > 0) ? (((num + den - 1) / den) * 5) : 0);
+  // Preamble is 12.25 symbols, so work in quarter symbols.
+  return((uint16_t)(((49 + (4 * uint32_t(nPayload))) * tSymUs) / 4000));
+  }
+
+// Returns true if a frame with the given payload size may be sent now; does not charge the budget.
+bool loRaAirtimeAllow(const uint8_t payloadBytes, const bool highPriority)
+  {
+  const uint16_t t = loRaTimeOnAirMs(payloadBytes);
+  const uint16_t floor = highPriority ? 0 : LORA_AIRTIME_RESERVE_MS;
+  return(loRaAirtimeMs >= t + floor);
+  }
+
+// Charge the budget for a frame with the given payload size once it has been queued to send.
+void loRaAirtimeCharge(const uint8_t payloadBytes)
+  {
+  const uint16_t t = loRaTimeOnAirMs(payloadBytes);
+  loRaAirtimeMs = (loRaAirtimeMs > t) ? (loRaAirtimeMs - t) : 0;
+  }
+
+// Refill the airtime budget; call once per minor cycle.
+static void loRaAirtimeTick()
+  {
+  loRaAirtimeMs = OTV0P2BASE::fnmin(uint16_t(loRaAirtimeMs + LORA_AIRTIME_REFILL_MS_PER_CYCLE), LORA_AIRTIME_MAX_MS);
+  }
+#endif // defined(ENABLE_RADIO_SECONDARY_RN2483)
+
+#if defined(ENABLE_TASK_BUDGETS) || defined(ENABLE_IDLE_CYCLE_SKIP)
+// Table of the once-per-minute tasks dispatched by switch(TIME_LSD) in loopOpenTRV(),
+// built at compile time with the same options as the switch cases.
+// Each entry gives the second of the minute that the task runs in (its phase; the period is always one minute),
+// its run-time budget in sub-cycle ticks, and whether it only runs with runAll,
+// ie may be skipped while conserving battery except in the sensor minute.
+// Keep in step with the cases in loopOpenTRV().
+struct MinuteTask final { uint8_t second; uint8_t budgetTicks; bool onlyRunAll; };
+static constexpr uint8_t TASK_BUDGET_SHORT = OTV0P2BASE::GSCT_MAX/8; // Most tasks.
+static constexpr uint8_t TASK_BUDGET_LONG = OTV0P2BASE::GSCT_MAX/2; // Radio TX and the valve computation.
+static constexpr MinuteTask minuteTasks[] =
+  {
+  { 0, TASK_BUDGET_SHORT, false }, // Minute count, schedules, RTC persistence, hourly/daily tasks.
+  { 2, TASK_BUDGET_SHORT, true }, // PRNG churn.
+  { 4, TASK_BUDGET_SHORT, true }, // Supply voltage.
+#if defined(ENABLE_STATS_TX)
+  { 6, TASK_BUDGET_SHORT, false }, // Stats TX slot choice.
+  { 8, TASK_BUDGET_LONG, false }, { 10, TASK_BUDGET_LONG, false }, { 12, TASK_BUDGET_LONG, false }, { 14, TASK_BUDGET_LONG, false }, // Stats TX.
+  { 16, TASK_BUDGET_LONG, false }, { 18, TASK_BUDGET_LONG, false }, { 20, TASK_BUDGET_LONG, false }, { 22, TASK_BUDGET_LONG, false },
+#endif
+#if defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_TX_SLOT_ALLOCATION)
+  { 30, TASK_BUDGET_LONG, false }, // Beacon TX.
+#endif
+#ifdef ENABLE_VOICE_SENSOR
+  { 46, TASK_BUDGET_SHORT, false }, // Voice sensor.
+#endif
+#ifdef TEMP_POT_AVAILABLE
+  { 48, TASK_BUDGET_SHORT, false }, // Temperature pot.
+#endif
+#ifdef HUMIDITY_SENSOR_SUPPORT
+  { 50, TASK_BUDGET_SHORT, true }, // Humidity.
+#endif
+#if defined(ENABLE_AMBLIGHT_SENSOR) || defined(TEMP_SENSOR_ASYNC) || (defined(ENABLE_DS18B20_BUS) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20))
+  { 52, TASK_BUDGET_SHORT, false }, // Ambient light, and starting temperature conversions.
+#endif
+  { 54, TASK_BUDGET_SHORT, false }, // Temperature and its trend.
+  { 56, TASK_BUDGET_LONG, false }, // Occupancy, valve and boiler computation.
+  { 58, TASK_BUDGET_SHORT, false }, // Non-volatile stats.
+  };
+static constexpr uint8_t MINUTE_TASKS = sizeof(minuteTasks) / sizeof(minuteTasks[0]);
+// Index in minuteTasks of the task running in the given second, from index i; MINUTE_TASKS if none.
+static constexpr uint8_t minuteTaskIndex(const uint8_t second, const uint8_t i = 0)
+  { return((i >= MINUTE_TASKS) ? MINUTE_TASKS : ((second == minuteTasks[i].second) ? i : minuteTaskIndex(second, i+1))); }
+static_assert(0 == minuteTaskIndex(0), "second 0 must always have a task");
+// True if a task is due in the minor cycle starting at the given second.
+static bool minuteTaskDue(const uint8_t second, const bool runAll)
+  {
+  const uint8_t i = minuteTaskIndex(second);
+  return((i < MINUTE_TASKS) && (runAll || !minuteTasks[i].onlyRunAll));
+  }
+// Next second at or after the given one (wrapping into the next minute) with a task due.
+// Always found, since second 0 has a task every minute.
+static uint8_t minuteTaskNextDue(uint8_t second, const bool runAll)
+  {
+  while(!minuteTaskDue(second, runAll)) { second = (second + 2) % 60; }
+  return(second);
+  }
+#endif // defined(ENABLE_TASK_BUDGETS) || defined(ENABLE_IDLE_CYCLE_SKIP)
+
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+// True while following minor cycles may be slept through, ie all per-cycle work is idle;
+// cleared by any wake-up other than the RTC tick, eg a button press, serial input or radio RX.
+static bool idleSkipOK;
+// Second at which the next minute task is due; minor cycles before it may be slept through.
+static uint8_t idleWakeS;
+// Minor cycles slept through since the last hourly reset (at most 1800).
+static uint16_t idleCyclesSkipped;
+#endif // defined(ENABLE_IDLE_CYCLE_SKIP)
+
+#if defined(ENABLE_TASK_BUDGETS)
+// Per-slot run-time budget checks for the once-per-minute task dispatch in loopOpenTRV().
+// One slot per even second of the minute (with the 2s RTC tick only even seconds are seen).
+static constexpr uint8_t TASK_SLOTS = 30;
+// Budget in sub-cycle ticks for the tasks run in the given slot (TIME_LSD/2), from the task table.
+// A slot with no minute task still has the per-cycle work (UI, boiler, radio polling) and gets the short budget.
+static constexpr uint8_t taskBudgetTicks(const uint8_t slot)
+  { return((minuteTaskIndex(2*slot) < MINUTE_TASKS) ? minuteTasks[minuteTaskIndex(2*slot)].budgetTicks : TASK_BUDGET_SHORT); }
+// Saturating count of budget overruns by slot since the last hourly reset.
+static uint8_t taskOverruns[TASK_SLOTS];
+// Record the time used by the tasks in the given slot, started at seconds sStart and sub-cycle time sctStart.
+// Running into any later minor cycle always counts as an overrun,
+// even if the sub-cycle time has since come back round past its start value.
+static void taskBudgetCheck(const uint8_t slot, const uint8_t sStart, const uint8_t sctStart)
+  {
+  const uint8_t sctEnd = OTV0P2BASE::getSubCycleTime();
+  const bool overrun = (sStart != OTV0P2BASE::getSecondsLT()) || (sctEnd < sctStart) ||
+      (uint8_t(sctEnd - sctStart) > taskBudgetTicks(slot));
+  if(overrun && (taskOverruns[slot] < 0xff)) { ++taskOverruns[slot]; }
+  }
+// Get the slot with the most overruns since the last reset, or 0xff if none.
+static uint8_t taskWorstSlot()
+  {
+  uint8_t worst = 0xff;
+  uint8_t worstCount = 0;
+  for(uint8_t i = 0; i < TASK_SLOTS; ++i)
+    { if(taskOverruns[i] > worstCount) { worst = i; worstCount = taskOverruns[i]; } }
+  return(worst);
+  }
+#endif // defined(ENABLE_TASK_BUDGETS)
+
+#if defined(ENABLE_ENERGY_LEDGER)
+// Per-board energy coefficients; currents in uA are used to the nearest 100uA except for sleep.
+// Defaults are rough figures for a REV7/DORM1-style board with an RFM23B at 1MHz CPU clock.
+#ifndef ENERGY_SLEEP_UA
+#define ENERGY_SLEEP_UA 5 // Whole-board current while asleep.
+#endif
+#ifndef ENERGY_AWAKE_UA
+#define ENERGY_AWAKE_UA 1000 // Additional current with CPU awake.
+#endif
+#ifndef ENERGY_TX_UA
+#define ENERGY_TX_UA 30000 // Additional current while primary radio transmitting.
+#endif
+#ifndef ENERGY_TX_US_PER_BYTE
+#define ENERGY_TX_US_PER_BYTE 163 // Air time per byte at ~49kbps.
+#endif
+#ifndef ENERGY_TX_OVERHEAD_BYTES
+#define ENERGY_TX_OVERHEAD_BYTES 12 // Preamble, sync and TX turnaround per frame, in byte times.
+#endif
+#ifndef ENERGY_RX_UA
+#define ENERGY_RX_UA 18500 // Additional current while primary radio listening.
+#endif
+#ifndef ENERGY_MOTOR_UA
+#define ENERGY_MOTOR_UA 50000 // Additional current while valve motor running.
+#endif
+#ifndef ENERGY_SENSOR_UA
+#define ENERGY_SENSOR_UA 1000 // Additional current during a sensor read (ADC, dividers, I2C device).
+#endif
+#ifndef ENERGY_SENSOR_MS_PER_READ
+#define ENERGY_SENSOR_MS_PER_READ 2
+#endif
+// Activity counters for the current hour.
+static uint32_t energyAwakeTicks; // Sub-cycle ticks awake.
+static uint32_t energyTXBytes; // Byte times of primary radio TX including per-frame overhead.
+static uint16_t energyRXCycles; // Minor cycles with primary radio listening.
+static uint32_t energyMotorTicks; // Sub-cycle ticks in the valve motor driver.
+static uint16_t energySensorReads;
+// Subsystems for which an average current is estimated.
+enum { ENERGY_CPU, ENERGY_TX, ENERGY_RX, ENERGY_MOTOR, ENERGY_SENSOR, ENERGY_SUBSYSTEMS };
+// Average current in uA by subsystem over the last full hour, and the total including sleep; 0 until then.
+static uint16_t energyAvgUA[ENERGY_SUBSYSTEMS];
+static uint16_t energyTotalUA;
+void energyLedgerTX(const uint8_t len, const bool doubleTX)
+  {
+  const uint16_t b = len + ENERGY_TX_OVERHEAD_BYTES;
+  energyTXBytes += doubleTX ? 2*b : b;
+  }
+// Note sub-cycle ticks used from sctStart to now, assuming running into the next minor cycle if time has wrapped.
+static uint8_t energyTicksSince(const uint8_t sctStart)
+  {
+  const uint8_t sctEnd = OTV0P2BASE::getSubCycleTime();
+  return((sctEnd >= sctStart) ? (sctEnd - sctStart) : (OTV0P2BASE::GSCT_MAX - sctStart));
+  }
+// Average current in uA over an hour for the given active time in ms at the given current.
+static uint16_t energyHourAvgUA(const uint32_t ms, const uint16_t uA)
+  { return((uint16_t)OTV0P2BASE::fnmin((ms * (uA / 100)) / 36000UL, (uint32_t)0xffff)); }
+// Convert this hour's counts to average currents and start a new hour.
+static void energyLedgerEndOfHour()
+  {
+  static constexpr uint8_t msPerTickNum = 125, msPerTickDen = 16; // 2000ms per GSCT_MAX+1 ticks.
+  energyAvgUA[ENERGY_CPU] = energyHourAvgUA((energyAwakeTicks * msPerTickNum) / msPerTickDen, ENERGY_AWAKE_UA);
+  energyAvgUA[ENERGY_TX] = energyHourAvgUA((energyTXBytes * ENERGY_TX_US_PER_BYTE) / 1000, ENERGY_TX_UA);
+  energyAvgUA[ENERGY_RX] = energyHourAvgUA(energyRXCycles * 2000UL, ENERGY_RX_UA);
+  energyAvgUA[ENERGY_MOTOR] = energyHourAvgUA((energyMotorTicks * msPerTickNum) / msPerTickDen, ENERGY_MOTOR_UA);
+  energyAvgUA[ENERGY_SENSOR] = energyHourAvgUA((uint32_t)energySensorReads * ENERGY_SENSOR_MS_PER_READ, ENERGY_SENSOR_UA);
+  uint32_t total = ENERGY_SLEEP_UA;
+  for(uint8_t i = 0; i < ENERGY_SUBSYSTEMS; ++i) { total += energyAvgUA[i]; }
+  energyTotalUA = (uint16_t)OTV0P2BASE::fnmin(total, (uint32_t)0xffff);
+  energyAwakeTicks = 0;
+  energyTXBytes = 0;
+  energyRXCycles = 0;
+  energyMotorTicks = 0;
+  energySensorReads = 0;
+  }
+#endif // defined(ENABLE_ENERGY_LEDGER)
+
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+// Adaptive sensor sampling: each sensor is read in its usual slot only every intervalM minutes.
+// The interval doubles (up to a per-sensor maximum) after each read that changed by no more than
+// a threshold, and drops back to every minute as soon as a read changes by more.
+#ifndef ADAPTIVE_TEMP_THRESHOLD_C16
+#define ADAPTIVE_TEMP_THRESHOLD_C16 2 // 1/8C.
+#endif
+#ifndef ADAPTIVE_TEMP_MAX_M
+#define ADAPTIVE_TEMP_MAX_M 4
+#endif
+#ifndef ADAPTIVE_LIGHT_THRESHOLD
+#define ADAPTIVE_LIGHT_THRESHOLD 4
+#endif
+#ifndef ADAPTIVE_LIGHT_MAX_M
+#define ADAPTIVE_LIGHT_MAX_M 2 // Keep response to lights being switched on prompt.
+#endif
+#ifndef ADAPTIVE_RH_THRESHOLD_PC
+#define ADAPTIVE_RH_THRESHOLD_PC 1
+#endif
+#ifndef ADAPTIVE_RH_MAX_M
+#define ADAPTIVE_RH_MAX_M 8
+#endif
+#ifndef ADAPTIVE_SUPPLY_THRESHOLD_CV
+#define ADAPTIVE_SUPPLY_THRESHOLD_CV 2
+#endif
+#ifndef ADAPTIVE_SUPPLY_MAX_M
+#define ADAPTIVE_SUPPLY_MAX_M 4 // No longer than the usual every-4-minutes cadence when conserving.
+#endif
+struct AdaptiveSampler
+  {
+  uint8_t intervalM; // Minutes between reads, >= 1.
+  uint8_t waitM; // Minutes until the next read.
+  int16_t last; // Value at the last read.
+  };
+static AdaptiveSampler tempSampler = { 1, 0, 0 };
+static AdaptiveSampler lightSampler = { 1, 0, 0 };
+static AdaptiveSampler rhSampler = { 1, 0, 0 };
+static AdaptiveSampler supplySampler = { 1, 0, 0 };
+// True if the sensor should be read this time round; call once per slot visit.
+static bool adaptiveSampleDue(AdaptiveSampler &a)
+  {
+  if(0 != a.waitM) { --a.waitM; return(false); }
+  return(true);
+  }
+// Note a fresh reading and set the interval to the next one.
+static void adaptiveSampleUpdate(AdaptiveSampler &a, const int16_t value, const uint8_t threshold, const uint8_t maxM)
+  {
+  const int16_t delta = value - a.last;
+  a.last = value;
+  const bool changed = (delta > (int16_t)threshold) || (delta < -(int16_t)threshold);
+  a.intervalM = changed ? 1 : OTV0P2BASE::fnmin((uint8_t)(a.intervalM * 2), maxM);
+  a.waitM = a.intervalM - 1;
+  }
+// Valve % at the last temperature slot, to see if the valve has moved since.
+static uint8_t adaptiveLastValvePC;
+// True if the valve is moving or has been moved since the last temperature slot.
+// The valve model then needs fresh temperatures, and motor runs pull the supply voltage down.
+static bool adaptiveValveMoving()
+  {
+#if defined(HAS_DORM1_VALVE_DRIVE) && defined(ENABLE_LOCAL_TRV)
+  if(ValveDirect.get() != NominalRadValve.get()) { return(true); }
+#endif
+  return(NominalRadValve.get() != adaptiveLastValvePC);
+  }
+#endif // defined(ENABLE_ADAPTIVE_SAMPLING)
+
+#if defined(ENABLE_ENTROPY_POOL)
+static constexpr uint8_t ENTROPY_POOL_BYTES = 16; // Must be a power of 2.
+static uint8_t entropyPool[ENTROPY_POOL_BYTES];
+static uint8_t entropyPoolPos;
+// Credited entropy in the pool in bits, capped at the pool size.
+static uint8_t entropyPoolBits;
+// Count of health test failures since the last hourly reset.
+static uint8_t entropyHealthFailures;
+// Repetition count test: a source fails if it gives the same sample this many times running.
+static constexpr uint8_t ENTROPY_RCT_CUTOFF = 12;
+// Adaptive proportion test: a source fails if the first sample of a window recurs this often within it.
+// A failed source is not credited until the start of its next window.
+static constexpr uint8_t ENTROPY_APT_WINDOW = 64;
+static constexpr uint8_t ENTROPY_APT_CUTOFF = 48;
+struct EntropySourceHealth
+  {
+  uint8_t last, repeats; // Repetition count test state.
+  uint8_t aptRef, aptCount, aptN; // Adaptive proportion test state.
+  bool failed;
+  };
+static EntropySourceHealth entropyHealth[ENTROPY_SOURCES];
+// Mix a byte into the pool at the current position
+// and carry it through every other byte with add-rotate-xor steps.
+// This only diffuses input across the pool; output is only ever taken through AES below.
+static void entropyPoolMix(const uint8_t b)
+  {
+  uint8_t carry = b;
+  for(uint8_t i = 0; i < ENTROPY_POOL_BYTES; ++i)
+    {
+    const uint8_t j = (entropyPoolPos + i) & (ENTROPY_POOL_BYTES-1);
+    uint8_t x = entropyPool[j] + carry + i;
+    x = (uint8_t)((x << 3) | (x >> 5));
+    entropyPool[j] = x;
+    carry ^= x;
+    }
+  entropyPoolPos = (entropyPoolPos + 1) & (ENTROPY_POOL_BYTES-1);
+  }
+void entropyPoolAdd(const uint8_t source, const uint8_t sample, const uint8_t estBits)
+  {
+  EntropySourceHealth &h = entropyHealth[source];
+  bool fail = false;
+  // Adaptive proportion test; a new window also gives a failed source another chance.
+  if(0 == h.aptN) { h.aptRef = sample; h.aptCount = 1; h.failed = false; }
+  else if((sample == h.aptRef) && (++h.aptCount >= ENTROPY_APT_CUTOFF)) { fail = true; }
+  if(++h.aptN >= ENTROPY_APT_WINDOW) { h.aptN = 0; }
+  // Repetition count test.
+  if(sample != h.last) { h.last = sample; h.repeats = 1; }
+  else
+    {
+    if(h.repeats < 0xff) { ++h.repeats; }
+    if(h.repeats >= ENTROPY_RCT_CUTOFF) { fail = true; }
+    }
+  if(fail && !h.failed)
+    {
+    h.failed = true;
+    if(entropyHealthFailures < 0xff) { ++entropyHealthFailures; }
+    }
+  entropyPoolMix(sample);
+  if(!h.failed)
+    { entropyPoolBits = OTV0P2BASE::fnmin((uint8_t)(entropyPoolBits + OTV0P2BASE::fnmin(estBits, (uint8_t)8)), (uint8_t)(8*ENTROPY_POOL_BYTES)); }
+  }
+// Count of extractions, so that each AES input block is distinct.
+static uint8_t entropyPoolExtractions;
+// Extract len [1,ENTROPY_POOL_BYTES] secure random bytes to buf, charging 8 bits of credit for each.
+// Output is AES-128 of a counter block keyed by the whole pool,
+// then the pool is replaced by a second such block so that output cannot be recovered from later state.
+// False (buf untouched) if the pool does not hold enough credited entropy.
+bool entropyPoolGetBytes(uint8_t *const buf, const uint8_t len)
+  {
+  if((0 == len) || (len > ENTROPY_POOL_BYTES) || (entropyPoolBits < 8*len)) { return(false); }
+  entropyPoolBits -= 8*len;
+  OTAESGCM::OTAES128E_default_t aes;
+  uint8_t block[ENTROPY_POOL_BYTES];
+  uint8_t out[ENTROPY_POOL_BYTES];
+  memset(block, 0, sizeof(block));
+  block[0] = ++entropyPoolExtractions;
+  aes.blockEncrypt(block, entropyPool, out);
+  block[1] = 1; // Rekey block.
+  uint8_t rekey[ENTROPY_POOL_BYTES];
+  aes.blockEncrypt(block, entropyPool, rekey);
+  memcpy(entropyPool, rekey, sizeof(entropyPool));
+  memcpy(buf, out, len);
+  // Don't leave secret material lying around on the stack.
+  memset(out, 0, sizeof(out));
+  memset(rekey, 0, sizeof(rekey));
+  return(true);
+  }
+// Replace the node ID with bytes from the pool, valid as ensureIDCreated(true) would make them.
+// False (ID untouched) if the pool does not hold enough credited entropy.
+bool entropyPoolResetID()
+  {
+  static_assert(V0P2BASE_EE_LEN_ID <= ENTROPY_POOL_BYTES, "ID too long for one extraction");
+  uint8_t id[V0P2BASE_EE_LEN_ID];
+  if(!entropyPoolGetBytes(id, sizeof(id))) { return(false); }
+  for(uint8_t i = 0; i < sizeof(id); ++i)
+    {
+    // Top bit always set; redraw the (rare) unusable 0xff value.
+    id[i] |= 0x80;
+    while(0xff == id[i])
+      { if(!entropyPoolGetBytes(id + i, 1)) { return(false); } id[i] |= 0x80; }
+    }
+  for(uint8_t i = 0; i < sizeof(id); ++i)
+    { OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)(V0P2BASE_EE_START_ID + i), id[i]); }
+  return(true);
+  }
+#endif // defined(ENABLE_ENTROPY_POOL)
+
+#if defined(ENABLE_ISR_EVENT_RING)
+// Number of slots in each event ring; must be a power of two no more than 128.
+// One slot is always left empty, so this holds one fewer event.
+#ifndef ISR_EVENT_RING_SIZE
+#define ISR_EVENT_RING_SIZE 8
+#endif
+// Kinds of event passed from interrupt (or other asynchronous) producers to the main loop.
+enum ISREventType : uint8_t
+  {
+  ISR_EVENT_BAKE, // MODE button pressed (simplified bake).
+  ISR_EVENT_VOICE, // Voice sensor triggered.
+  ISR_EVENT_SERIAL_RX, // Activity on serial RX; arg unused.
+  ISR_EVENT_CALL_FOR_HEAT // Remote call for heat, queued from the main loop; arg is caller ID.
+  };
+// One event, stamped with the sub-cycle time at which it was published.
+struct ISREvent { ISREventType type; uint8_t sct; uint16_t arg; };
+// Single-producer/single-consumer lock-free event ring.
+// Only the producer writes head and overflows, and only the consumer writes tail.
+// Each is a single byte, so each side can read the other's index without a lock.
+// A slot is fully written before head moves on to publish it,
+// and the producer does not reuse it until tail has moved past it.
+// When full the new event is dropped and counted, so unread events are never overwritten.
+template<uint8_t N>
+class ISREventRing final
+  {
+    static_assert((0 != N) && (0 == (N & (N-1))) && (N <= 128), "ring size must be a power of two <= 128");
+  private:
+    volatile ISREvent buf[N];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile uint8_t overflows;
+  public:
+    // Publish an event; call only from the ring's one producer.
+    // Returns false if the ring was full and the event was dropped.
+    bool push(const ISREventType type, const uint16_t arg = 0)
+      {
+      const uint8_t h = head;
+      const uint8_t next = (h + 1) & (N - 1);
+      if(next == tail) { if(overflows < 255) { ++overflows; } return(false); }
+      buf[h].type = type;
+      buf[h].sct = OTV0P2BASE::getSubCycleTime();
+      buf[h].arg = arg;
+      head = next;
+      return(true);
+      }
+    // Take the oldest event into e; call only from the ring's one consumer.
+    // Returns false if there is none.
+    bool pop(ISREvent &e)
+      {
+      const uint8_t t = tail;
+      if(head == t) { return(false); }
+      e.type = buf[t].type;
+      e.sct = buf[t].sct;
+      e.arg = buf[t].arg;
+      tail = (t + 1) & (N - 1);
+      return(true);
+      }
+    // Events dropped because the ring was full, saturating at 255.
+    uint8_t getOverflows() const { return(overflows); }
+  };
+// Events from the pin-change ISRs.
+static ISREventRing<ISR_EVENT_RING_SIZE> isrEvents;
+#if defined(ENABLE_BOILER_HUB)
+// Calls for heat from RX decoding (remoteCallForHeatRX()), which runs in the main loop, not an ISR;
+// queued separately so that the pin-change ISRs stay the only producer for isrEvents.
+static ISREventRing<ISR_EVENT_RING_SIZE> cfhEvents;
+#endif
+// Worst delay this hour from publishing an event to handling it, in sub-cycle ticks.
+// Assumes that events are handled within one sub-cycle (2s), as they normally are.
+static uint8_t isrEventMaxLatency;
+static void isrEventHandled(const ISREvent &e)
+  {
+  const uint8_t latency = OTV0P2BASE::getSubCycleTime() - e.sct;
+  if(latency > isrEventMaxLatency) { isrEventMaxLatency = latency; }
+  }
+// Total events dropped from all rings, saturating at 255.
+static uint8_t isrEventOverflows()
+  {
+#if defined(ENABLE_BOILER_HUB)
+  return((uint8_t)OTV0P2BASE::fnmin(255U, (unsigned)isrEvents.getOverflows() + cfhEvents.getOverflows()));
+#else
+  return(isrEvents.getOverflows());
+#endif
+  }
+// Run the main-loop handlers for all pending pin-change events, oldest first.
+static void drainISREvents()
+  {
+  ISREvent e;
+  while(isrEvents.pop(e))
+    {
+    isrEventHandled(e);
+    switch(e.type)
+      {
+#if defined(ENABLE_SIMPLIFIED_MODE_BAKE)
+      case ISR_EVENT_BAKE: { valveUI.startBakeFromInt(); break; }
+#endif
+#if defined(ENABLE_VOICE_SENSOR)
+      case ISR_EVENT_VOICE: { Voice.handleInterruptSimple(); break; }
+#endif
+      case ISR_EVENT_SERIAL_RX: { OTV0P2BASE::CLI::resetCLIActiveTimer(); break; }
+      default: { break; }
+      }
+    }
+  }
+#endif // defined(ENABLE_ISR_EVENT_RING)
+
 #ifdef ENABLE_STATS_TX
 #if defined(ENABLE_JSON_OUTPUT)
 // Managed JSON stats.
-static OTV0P2BASE::SimpleStatsRotation<12> ss1; // Configured for maximum different stats.	// FIXME increased for voice & for setback lockout
+// Capacity for every distinct stat that bareStatsTX() can put with the enabled options,
+// since put() silently refuses any new key once the rotation is full.
+// Core: error, temperature, humidity, 2-bit occupancy, vacancy, supply, boiler, light,
+// valve, target, setback, cumulative movement.
+static const uint8_t SS1_MAX_STATS = 12
+#ifdef ENABLE_VOICE_STATS
+  + 1 // voice
+#endif
+#ifdef ENABLE_SETBACK_LOCKOUT_COUNTDOWN
+  + 1 // gE
+#endif
+#if defined(ENABLE_DS18B20_BUS)
+  + DS18B20_BUS_MAX_PROBES // Tn
+#endif
+#if defined(ENABLE_OCCUPANCY_FUSION)
+  + 1 // oc
+#endif
+#ifdef ENABLE_BOILER_HUB
+  + 6 // hn hc hd bc bd bx
+#endif
+#if defined(ENABLE_MOULD_RISK_MODE)
+  + 2 // mr mR
+#endif
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+  + 2 // wo Ts
+#endif
+#if defined(ENABLE_PREDICTIVE_PREHEAT)
+  + 1 // pR
+#endif
+#if defined(ENABLE_SIMULATED_ROOM)
+  + 2 // sE sV
+#endif
+#ifdef ENABLE_RADIO_SECONDARY_MODULE
+  + 1 // R2
+#endif
+#if defined(ENABLE_ENERGY_LEDGER)
+  + 6 // eD eC eT eR eM eS
+#endif
+#if defined(ENABLE_BOOT_TIME_STAT)
+  + 1 // bT
+#endif
+#if defined(ENABLE_ENTROPY_POOL)
+  + 1 // rH
+#endif
+#if defined(ENABLE_TASK_BUDGETS)
+  + 2 // tO tN
+#endif
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+  + 1 // cS
+#endif
+#if defined(ENABLE_ISR_EVENT_RING)
+  + 2 // iO iL
+#endif
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  + 1 // Lb
+#endif
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+  + 3 // Rq Ra Rd
+#endif
+  ;
+static OTV0P2BASE::SimpleStatsRotation<SS1_MAX_STATS> ss1;
+// Count of puts refused by ss1 (capacity reached, so that stat is never sent); should stay 0.
+static uint8_t ss1Refused;
+// Note the result of an ss1.put(); a refusal means the rotation has no room for a new stat.
+static inline void ss1Note(const bool putOK) { if(!putOK && (ss1Refused < 255)) { ++ss1Refused; } }
+#if defined(ENABLE_DS18B20_BUS)
+// Only tags T0 to T3 exist below; more probes would all be reported as T3.
+static_assert(DS18B20_BUS_MAX_PROBES <= 4, "DS18B20_BUS_MAX_PROBES > 4 needs more Tn stats tags");
+// Put the given DS18B20 probe's temperature into the stats as Tn|C16, if valid.
+static void putDS18B20Probe(const uint8_t i)
+  {
+  const int16_t t = ds18b20Bus.get(i);
+  if(OTV0P2BASE::TemperatureC16Base::DEFAULT_INVALID_TEMP == t) { return; }
+  switch(i)
+    {
+    case 0: { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("T0|C16"), t)); break; }
+    case 1: { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("T1|C16"), t)); break; }
+    case 2: { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("T2|C16"), t)); break; }
+    default: { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("T3|C16"), t)); break; }
+    }
+  }
+#endif // defined(ENABLE_DS18B20_BUS)
 #endif // ENABLE_STATS_TX
 // Do bare stats transmission.
 // Output should be filtered for items appropriate
@@ -264,42 +1159,131 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("Bin gen err!");
 #ifdef OTV0P2BASE_ErrorReport_DEFINED
     ss1.putOrRemove(OTV0P2BASE::ErrorReporter);
 #endif
-    ss1.put(TemperatureC16);
+    ss1Note(ss1.put(TemperatureC16));
+#if defined(ENABLE_DS18B20_BUS)
+    // Show each DS18B20 probe not already shown as the room temperature.
+#if defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+    for(uint8_t i = 1; i < ds18b20Bus.getProbeCount(); ++i) { putDS18B20Probe(i); }
+#else
+    for(uint8_t i = 0; i < ds18b20Bus.getProbeCount(); ++i) { putDS18B20Probe(i); }
+#endif
+#endif // defined(ENABLE_DS18B20_BUS)
 #if defined(HUMIDITY_SENSOR_SUPPORT)
-    ss1.put(RelHumidity);
+    ss1Note(ss1.put(RelHumidity));
 #endif // defined(HUMIDITY_SENSOR_SUPPORT)
 #if defined(ENABLE_OCCUPANCY_SUPPORT)
-    ss1.put(Occupancy.twoBitTag(), Occupancy.twoBitOccupancyValue()); // Reduce spurious TX cf percentage.
+    ss1Note(ss1.put(Occupancy.twoBitTag(), Occupancy.twoBitOccupancyValue())); // Reduce spurious TX cf percentage.
 #if !defined(ENABLE_TRIMMED_BANDWIDTH)
-    ss1.put(Occupancy.vacHSubSensor);
+    ss1Note(ss1.put(Occupancy.vacHSubSensor));
+#if defined(ENABLE_OCCUPANCY_FUSION)
+    // Fused occupancy confidence %.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("oc"), occupancyFusionConfidencePC(), true));
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
 #endif // !defined(ENABLE_TRIMMED_BANDWIDTH)
 #endif // defined(ENABLE_OCCUPANCY_SUPPORT)
     // OPTIONAL items
     // Only TX supply voltage for units apparently not mains powered, and TX with low priority as slow changing.
-    if(!Supply_cV.isMains()) { ss1.put(Supply_cV, true); } else { ss1.remove(Supply_cV.tag()); }
+    if(!Supply_cV.isMains()) { ss1Note(ss1.put(Supply_cV, true)); } else { ss1.remove(Supply_cV.tag()); }
 #ifdef ENABLE_BOILER_HUB
     // Show boiler state for boiler hubs.
-    ss1.put(V0p2_SENSOR_TAG_F("b"), (int) isBoilerOn());
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("b"), (int) isBoilerOn()));
+    // Show valves heard from, valves calling for heat, and their aggregate demand.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("hn"), hubDemandValves(false), true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("hc"), hubDemandValves(true)));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("hd"), hubDemandAggregatePC()));
+    // Show boiler cycles per hour, duty cycle % and adaptive extra minimum on/off minutes.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("bc"), boilerCyclesPerHour(), true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("bd"), boilerDutyPC(), true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("bx"), boilerCycleExtraM(), true));
 #endif // ENABLE_BOILER_HUB
 #ifdef ENABLE_AMBLIGHT_SENSOR
-    ss1.put(AmbLight); // Always send ambient light level (assuming sensor is present).
+    ss1Note(ss1.put(AmbLight)); // Always send ambient light level (assuming sensor is present).
 #endif // ENABLE_AMBLIGHT_SENSOR
 #ifdef ENABLE_VOICE_STATS
-    ss1.put(Voice);
+    ss1Note(ss1.put(Voice));
 #endif // ENABLE_VOICE_STATS
 #if defined(ENABLE_LOCAL_TRV)
     // Show TRV-related stats since enabled.
-    ss1.put(NominalRadValve); // Show modelled value to be able to deduce call-for-heat.
-    ss1.put(NominalRadValve.targetTemperatureSubSensor);
-    ss1.put(NominalRadValve.setbackSubSensor);
+    ss1Note(ss1.put(NominalRadValve)); // Show modelled value to be able to deduce call-for-heat.
+    ss1Note(ss1.put(NominalRadValve.targetTemperatureSubSensor));
+    ss1Note(ss1.put(NominalRadValve.setbackSubSensor));
 #if !defined(ENABLE_TRIMMED_BANDWIDTH)
-    ss1.put(NominalRadValve.cumulativeMovementSubSensor);
+    ss1Note(ss1.put(NominalRadValve.cumulativeMovementSubSensor));
 #endif // !defined(ENABLE_TRIMMED_BANDWIDTH)
 #endif // defined(ENABLE_LOCAL_TRV)
 #ifdef ENABLE_SETBACK_LOCKOUT_COUNTDOWN
     // Show state of setback lockout.
-    ss1.put(V0p2_SENSOR_TAG_F("gE"), OTRadValve::getSetbackLockout(), true);
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("gE"), OTRadValve::getSetbackLockout(), true));
 #endif // ENABLE_SETBACK_LOCKOUT_COUNTDOWN
+#if defined(ENABLE_MOULD_RISK_MODE)
+    // Show mould-risk flag and risk hours over the last day.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("mr"), (int) isMouldRisk()));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("mR"), mouldRiskHours(), true));
+#endif // defined(ENABLE_MOULD_RISK_MODE)
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+    // Show minutes in window-open state (0 if not) and the detector's temperature slope (C16 per hour).
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("wo"), windowOpenMinutes()));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("Ts"), windowOpenSlopeC16PerH(), true));
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
+#if defined(ENABLE_PREDICTIVE_PREHEAT)
+    // Show learned warm-up rate (C16 per hour) for the current room temperature, if any.
+    { const uint8_t pR = getPreheatRateC16PerH(); if(0xff != pR) { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("pR"), pR, true)); } }
+#endif // defined(ENABLE_PREDICTIVE_PREHEAT)
+#if defined(ENABLE_SIMULATED_ROOM)
+    // Show simulated-room closed-loop mean comfort error (C16) and mean valve % open over the last hour.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("sE"), simComfortErrC16, true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("sV"), simValvePC, true));
+#endif // defined(ENABLE_SIMULATED_ROOM)
+#ifdef ENABLE_RADIO_SECONDARY_MODULE
+    // Show worst-case secondary radio poll time (sub-cycle ticks) over the last hour or so.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("R2"), secondaryRadioPollMaxTicks, true));
+#endif // ENABLE_RADIO_SECONDARY_MODULE
+#if defined(ENABLE_ENERGY_LEDGER)
+    // Show estimated drain over the last full hour as mAh/day in tenths, and average uA by subsystem.
+    if(0 != energyTotalUA)
+      {
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eD"), (int)((energyTotalUA * 24UL) / 100), true));
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eC"), energyAvgUA[ENERGY_CPU], true));
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eT"), energyAvgUA[ENERGY_TX], true));
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eR"), energyAvgUA[ENERGY_RX], true));
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eM"), energyAvgUA[ENERGY_MOTOR], true));
+      ss1Note(ss1.put(V0p2_SENSOR_TAG_F("eS"), energyAvgUA[ENERGY_SENSOR], true));
+      }
+#endif // defined(ENABLE_ENERGY_LEDGER)
+#if defined(ENABLE_BOOT_TIME_STAT)
+    // Show time from the boot xtal check to first valve computation (ms).
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("bT"), bootTimeMs, true));
+#endif // defined(ENABLE_BOOT_TIME_STAT)
+#if defined(ENABLE_ENTROPY_POOL)
+    // Show entropy source health test failures this hour, if any.
+    if(0 != entropyHealthFailures) { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("rH"), entropyHealthFailures, true)); }
+#endif // defined(ENABLE_ENTROPY_POOL)
+#if defined(ENABLE_TASK_BUDGETS)
+    // Show the second of the minute whose tasks most often overran their budget this hour, and how often.
+    { const uint8_t w = taskWorstSlot(); if(0xff != w) { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("tO"), 2*w, true)); ss1Note(ss1.put(V0p2_SENSOR_TAG_F("tN"), taskOverruns[w], true)); } }
+#endif // defined(ENABLE_TASK_BUDGETS)
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+    // Show the minor cycles slept through this hour (of 1800).
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("cS"), idleCyclesSkipped, true));
+#endif // defined(ENABLE_IDLE_CYCLE_SKIP)
+#if defined(ENABLE_ISR_EVENT_RING)
+    // Show dropped interrupt events (since boot) if any, and the worst handling delay this hour.
+    { const uint8_t o = isrEventOverflows(); if(0 != o) { ss1Note(ss1.put(V0p2_SENSOR_TAG_F("iO"), o, true)); } }
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("iL"), isrEventMaxLatency, true));
+#endif // defined(ENABLE_ISR_EVENT_RING)
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+    // Show LoRa airtime budget remaining as a percentage of the maximum.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("Lb"), (int)(loRaAirtimeMs / (LORA_AIRTIME_MAX_MS / 100)), true));
+#endif // defined(ENABLE_RADIO_SECONDARY_RN2483)
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+    // Show relay store-and-forward queue depth, oldest frame age (minutes) and drop count.
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("Rq"), relayStoreDepth(), true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("Ra"), relayStoreOldestAgeM(), true));
+    ss1Note(ss1.put(V0p2_SENSOR_TAG_F("Rd"), relayStoreDropCount(), true));
+#endif // ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+#if 1 && defined(DEBUG)
+    if(0 != ss1Refused) { DEBUG_SERIAL_PRINTLN_FLASHSTRING("!stats full"); }
+#endif
 #if defined(ENABLE_ALWAYS_TX_ALL_STATS)
     const uint8_t privacyLevel = OTV0P2BASE::stTXalwaysAll;
 #else
@@ -420,7 +1404,19 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("JSON gen err!");
       // Write out unadjusted JSON or encrypted frame on secondary radio.
 //      SecondaryRadio.queueToSend(realTXFrameStart, doEnc ? (bptr - realTXFrameStart) : wrote);
       // Assumes that framing (or not) of primary and secondary radios is the same (usually: both framed).
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+  #ifdef ENABLE_BOILER_HUB
+      // Boiler state from a boiler hub goes ahead of relayed routine stats.
+      relayQueueToSend(realTXFrameStart, wrote, true);
+  #else
+      relayQueueToSend(realTXFrameStart, wrote, false);
+  #endif // ENABLE_BOILER_HUB
+#elif defined(ENABLE_RADIO_SECONDARY_RN2483)
+      // Skip routine stats if they would bust the LoRa duty-cycle budget; fresh values will follow.
+      if(loRaAirtimeAllow(wrote, false) && SecondaryRadio.queueToSend(realTXFrameStart, wrote)) { loRaAirtimeCharge(wrote); }
+#else
       SecondaryRadio.queueToSend(realTXFrameStart, wrote);
+#endif // ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
       }
 #endif // ENABLE_RADIO_SECONDARY_MODULE
 
@@ -455,6 +1451,9 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("JSON gen err!");
 #endif
         {
         // Send directly to the primary radio...
+#if defined(ENABLE_ENERGY_LEDGER)
+        energyLedgerTX(wrote);
+#endif
         if(!PrimaryRadio.queueToSend(realTXFrameStart, wrote)) { sendingJSONFailed = true; }
         }
       }
@@ -482,18 +1481,31 @@ static void wireComponentsTogether()
 #endif // ENABLE_FHT8VSIMPLE
 
 #if defined(ENABLE_OCCUPANCY_SUPPORT) && defined(ENABLE_OCCUPANCY_DETECTION_FROM_AMBLIGHT)
+#if defined(ENABLE_OCCUPANCY_FUSION)
+  AmbLight.setOccCallbackOpt([](bool prob){occupancyFusionEvent(prob ? OCC_FUSION_WEIGHT_LIGHT_STRONG : OCC_FUSION_WEIGHT_LIGHT_WEAK);});
+#else
   AmbLight.setOccCallbackOpt([](bool prob){if(prob){Occupancy.markAsPossiblyOccupied();}else{Occupancy.markAsJustPossiblyOccupied();}});
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
 #endif // ENABLE_OCCUPANCY_DETECTION_FROM_AMBLIGHT
 
 #if defined(ENABLE_OCCUPANCY_SUPPORT) && defined(ENABLE_OCCUPANCY_DETECTION_FROM_VOICE)
+#if defined(ENABLE_OCCUPANCY_FUSION)
+  Voice.setPossOccCallback([]{occupancyFusionEvent(OCC_FUSION_WEIGHT_VOICE);});
+#else
   Voice.setPossOccCallback([]{Occupancy.markAsPossiblyOccupied();});
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
 #endif // ENABLE_OCCUPANCY_DETECTION_FROM_VOICE
 
 #if defined(TEMP_POT_AVAILABLE) && defined(valveUI_DEFINED)
   // Callbacks to set various mode combinations.
   // Typically at most one call would be made on any appropriate pot adjustment.
+#if defined(ENABLE_OCCUPANCY_FUSION)
+  TempPot.setWFBCallbacks([](bool x){occupancyFusionEvent(OCC_FUSION_WEIGHT_UI); valveUI.setWarmModeFromManualUI(x);},
+                          [](bool x){occupancyFusionEvent(OCC_FUSION_WEIGHT_UI); valveUI.setBakeModeFromManualUI(x);});
+#else
   TempPot.setWFBCallbacks([](bool x){valveUI.setWarmModeFromManualUI(x);},
                           [](bool x){valveUI.setBakeModeFromManualUI(x);});
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
 #endif // TEMP_POT_AVAILABLE
 
 #if V0p2_REV == 14
@@ -521,13 +1533,443 @@ static void updateSensorsFromStats()
           eeStats.getMaxByHourStat(OTV0P2BASE::NVByHourByteStatsBase::STATS_SET_AMBLIGHT_BY_HOUR_SMOOTHED),
           !tempControl.hasEcoBias());
 #endif // ENABLE_OCCUPANCY_DETECTION_FROM_AMBLIGHT
+#if defined(ENABLE_OCCUPANCY_FUSION)
+  occupancyFusionUpdatePrior();
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
+  }
+
+#if defined(ENABLE_MOULD_RISK_MODE)
+// Room temperature minus dew point (C16) at or below which there is mould risk.
+// 6C corresponds to about 68% RH at 20C, so surfaces ~3C cooler than the air reach ~80%.
+#ifndef MOULD_RISK_MARGIN_C16
+#define MOULD_RISK_MARGIN_C16 (6*16)
+#endif
+// Extra margin (C16) needed to leave the risk state, to avoid flapping.
+static constexpr uint8_t MOULD_RISK_HYSTERESIS_C16 = 8;
+// ln(RH/100) in Q12 for RH 20%, 22%, ... 100%, interpolated linearly in between.
+static const int16_t lnRHQ12[41] PROGMEM =
+  {
+  -6592, -6202, -5845, -5518, -5214, -4931, -4667, -4419, -4185, -3963,
+  -3753, -3553, -3363, -3181, -3006, -2839, -2678, -2524, -2375, -2231,
+  -2092, -1958, -1828, -1702, -1580, -1461, -1346, -1233, -1124, -1018,
+  -914, -813, -714, -618, -524, -432, -342, -253, -167, -83,
+  0
+  };
+// Magnus coefficients b = 17.62 (Q12) and c = 243.12C (C16).
+static constexpr int32_t MAGNUS_B_Q12 = 72172;
+static constexpr int16_t MAGNUS_C_C16 = 3890;
+// Divide, rounding to nearest; d must be strictly positive.
+static int32_t divRound(const int32_t n, const int32_t d) { return((n >= 0) ? ((n + d/2) / d) : -((d/2 - n) / d)); }
+int16_t dewPointC16(const int16_t tempC16, const uint8_t rhPC)
+  {
+  const uint8_t rh = OTV0P2BASE::fnmax((uint8_t)20, OTV0P2BASE::fnmin((uint8_t)100, rhPC));
+  const uint8_t i = (rh - 20) / 2;
+  const int16_t lo = (int16_t)pgm_read_word(&lnRHQ12[i]);
+  const int16_t ln = (0 == (rh & 1)) ? lo : (int16_t)(lo + divRound((int16_t)pgm_read_word(&lnRHQ12[i+1]) - lo, 2));
+  // gamma = ln(RH/100) + b.T/(c+T), then Td = c.gamma/(b-gamma).
+  const int32_t gamma = ln + divRound(MAGNUS_B_Q12 * tempC16, MAGNUS_C_C16 + tempC16);
+  return((int16_t)divRound(MAGNUS_C_C16 * gamma, MAGNUS_B_Q12 - gamma));
+  }
+#if defined(DEBUG)
+// Test vectors: temperature (C), RH (%) and dew point (C16) from the floating-point Magnus formula, rounded.
+static const int16_t dewPointTestVectors[][3] PROGMEM =
+  {
+  { -5, 80, -127 }, { 0, 50, -147 }, { 10, 90, 135 }, { 16, 65, 151 },
+  { 18, 75, 216 }, { 20, 40, 96 }, { 20, 60, 192 }, { 21, 20, -45 },
+  { 22, 55, 201 }, { 25, 100, 400 }, { 30, 35, 206 }, { 40, 85, 592 },
+  };
+bool dewPointC16SelfTest()
+  {
+  for(uint8_t i = 0; i < sizeof(dewPointTestVectors)/sizeof(dewPointTestVectors[0]); ++i)
+    {
+    const int16_t t = (int16_t)pgm_read_word(&dewPointTestVectors[i][0]);
+    const uint8_t rh = (uint8_t)pgm_read_word(&dewPointTestVectors[i][1]);
+    const int16_t expected = (int16_t)pgm_read_word(&dewPointTestVectors[i][2]);
+    const int16_t err = dewPointC16(16*t, rh) - expected;
+    if((err > 1) || (err < -1)) { return(false); }
+    }
+  return(true);
+  }
+#endif // defined(DEBUG)
+static bool mouldRisk;
+bool isMouldRisk() { return(mouldRisk); }
+// Minutes of risk so far this hour.
+static uint8_t mouldRiskThisHourM;
+void mouldRiskMinute(const bool fresh)
+  {
+  const uint8_t rh = RelHumidity.get();
+  const int16_t t = TemperatureC16.get();
+  if((rh > 100) || TemperatureC16.isErrorValue(t)) { return; }
+  if(fresh)
+    {
+    const int16_t margin = t - dewPointC16(t, rh);
+    mouldRisk = margin <= (MOULD_RISK_MARGIN_C16 + (mouldRisk ? MOULD_RISK_HYSTERESIS_C16 : 0));
+    }
+  if(mouldRisk && (mouldRiskThisHourM < 60)) { ++mouldRiskThisHourM; }
+  }
+// Record this hour's risk minutes in the USER1 stats set, and restart the count; call at end of each hour.
+static void mouldRiskEndOfHour()
+  {
+  eeStats.setByHourStat(OTV0P2BASE::NVByHourByteStatsBase::STATS_SET_USER1_BY_HOUR, OTV0P2BASE::getHoursLT(), mouldRiskThisHourM);
+  mouldRiskThisHourM = 0;
+  }
+uint8_t mouldRiskHours()
+  {
+  uint8_t n = 0;
+  for(uint8_t hh = 0; hh < 24; ++hh)
+    {
+    const uint8_t m = eeStats.getByHourStat(OTV0P2BASE::NVByHourByteStatsBase::STATS_SET_USER1_BY_HOUR, hh);
+    if((m <= 60) && (m >= 30)) { ++n; }
+    }
+  return(n);
+  }
+#endif // defined(ENABLE_MOULD_RISK_MODE)
+
+#if defined(ENABLE_OCCUPANCY_FUSION)
+// Fused score at or above which the room is marked possibly occupied, and just-possibly occupied.
+#ifndef OCC_FUSION_POSSIBLE_SCORE
+#define OCC_FUSION_POSSIBLE_SCORE 128
+#endif
+#ifndef OCC_FUSION_JUST_POSSIBLE_SCORE
+#define OCC_FUSION_JUST_POSSIBLE_SCORE 32
+#endif
+// Minimum rise in RH% over one minute taken as evidence of occupancy.
+#ifndef OCC_FUSION_RH_RISE_PC
+#define OCC_FUSION_RH_RISE_PC 3
+#endif
+// Decaying evidence score [0,255].
+static uint8_t occFusionScore;
+// Prior for this hour: smoothed % occupancy from stats, scaled to at most half the 'possible' score.
+static uint8_t occFusionPrior;
+void occupancyFusionUpdatePrior()
+  {
+  const uint8_t pc = eeStats.getByHourStatRTC(OTV0P2BASE::NVByHourByteStatsBase::STATS_SET_OCCPC_BY_HOUR_SMOOTHED);
+  occFusionPrior = (pc > 100) ? 0 : (uint8_t)((pc * (uint16_t)(OCC_FUSION_POSSIBLE_SCORE/2)) / 100);
+  }
+void occupancyFusionEvent(const uint8_t weight)
+  {
+  occFusionScore = (uint8_t)OTV0P2BASE::fnmin(255U, (unsigned)occFusionScore + weight);
+  // Usually-occupied hours need less fresh evidence.
+  const uint16_t evidence = (uint16_t)occFusionScore + occFusionPrior;
+  if(evidence >= OCC_FUSION_POSSIBLE_SCORE) { Occupancy.markAsPossiblyOccupied(); }
+  else if(evidence >= OCC_FUSION_JUST_POSSIBLE_SCORE) { Occupancy.markAsJustPossiblyOccupied(); }
+  }
+void occupancyFusionMinute()
+  {
+  occFusionScore -= (uint8_t)((occFusionScore + 15) / 16);
+#if defined(HUMIDITY_SENSOR_SUPPORT)
+  static uint8_t lastRH = 0xff;
+  const uint8_t rh = RelHumidity.get();
+  if((rh <= 100) && (lastRH <= 100) && (rh >= lastRH + OCC_FUSION_RH_RISE_PC)) { occupancyFusionEvent(OCC_FUSION_WEIGHT_RH_RISE); }
+  lastRH = rh;
+#endif // defined(HUMIDITY_SENSOR_SUPPORT)
+  }
+uint8_t occupancyFusionConfidencePC()
+  { return((uint8_t)OTV0P2BASE::fnmin(100U, (((unsigned)occFusionScore + occFusionPrior) * 100U) / OCC_FUSION_POSSIBLE_SCORE)); }
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
+
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+// Fall rate (C16 per hour) over the recent temperature samples taken to mean a window has been opened.
+// Heating alone cannot produce this, and a closed room cools much more slowly.
+#ifndef WINDOW_OPEN_FALL_C16_PER_H
+#define WINDOW_OPEN_FALL_C16_PER_H 48 // 3C/h.
+#endif
+// Minimum and maximum time (minutes) to stay in the window-open state.
+#ifndef WINDOW_OPEN_MIN_M
+#define WINDOW_OPEN_MIN_M 10
+#endif
+#ifndef WINDOW_OPEN_MAX_M
+#define WINDOW_OPEN_MAX_M 60
+#endif
+// Number of per-minute temperature samples in the detector's own slope window.
+// The smoothed tempTrendC16 takes ~17 minutes to show a 3C/h fall;
+// a least-squares fit over this short window sees it after ~7 minutes, 4C/h after ~4 and 10C/h after ~2,
+// while sensor flicker of 2 LSBs gives at most ~31 C16/h of apparent slope.
+#ifndef WINDOW_OPEN_SAMPLES
+#define WINDOW_OPEN_SAMPLES 6
+#endif
+static_assert((WINDOW_OPEN_SAMPLES >= 3) && (WINDOW_OPEN_SAMPLES <= 15), "WINDOW_OPEN_SAMPLES out of range");
+// Last WINDOW_OPEN_SAMPLES temperatures (C16), one per minute, oldest at windowOpenSamplesNext.
+static int16_t windowOpenSamples[WINDOW_OPEN_SAMPLES];
+static uint8_t windowOpenSamplesNext;
+// Running sum of the samples and of each sample weighted by its age rank (0 oldest), so the slope is O(1).
+static int32_t windowOpenSum, windowOpenSumK;
+// Minutes spent so far in the window-open state; 0 when not in it.
+static uint8_t windowOpenM;
+// True while the WARM mode in force on entry to the window-open state would still be in force now;
+// cleared if a scheduled WARM period ends during the hold.
+static bool windowOpenKeepWarm;
+// True if a schedule was calling for WARM at the last tick of the hold.
+static bool windowOpenScheduleWarm;
+bool isWindowOpen() { return(0 != windowOpenM); }
+void windowOpenCancel() { windowOpenM = 0; }
+uint8_t windowOpenMinutes() { return(windowOpenM); }
+// Add the latest temperature to the slope window; the first sample fills the whole window (zero slope).
+static void windowOpenSample(const int16_t tC16)
+  {
+  static bool primed;
+  const uint8_t n = WINDOW_OPEN_SAMPLES;
+  if(!primed)
+    {
+    for(uint8_t i = 0; i < n; ++i) { windowOpenSamples[i] = tC16; }
+    windowOpenSum = (int32_t)n * tC16;
+    windowOpenSumK = (int32_t)((n * (n - 1)) / 2) * tC16;
+    primed = true;
+    return;
+    }
+  const int16_t oldest = windowOpenSamples[windowOpenSamplesNext];
+  windowOpenSamples[windowOpenSamplesNext] = tC16;
+  if(++windowOpenSamplesNext >= n) { windowOpenSamplesNext = 0; }
+  // Every remaining sample ages by one rank and the new one takes rank n-1.
+  windowOpenSumK += (oldest - windowOpenSum) + (int32_t)(n - 1) * tC16;
+  windowOpenSum += tC16 - oldest;
+  }
+int16_t windowOpenSlopeC16PerH()
+  {
+  const int32_t n = WINDOW_OPEN_SAMPLES;
+  const int32_t sumK = (n * (n - 1)) / 2;
+  const int32_t sumKK = ((n - 1) * n * ((2 * n) - 1)) / 6;
+  return((int16_t)((((n * windowOpenSumK) - (sumK * windowOpenSum)) * 60) / ((n * sumKK) - (sumK * sumK))));
+  }
+// True if any schedule is calling for WARM now.
+static bool windowOpenIsScheduleWarm()
+  {
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+  if(weeklyScheduleIsWarm(weeklyScheduleDayOfWeek(), OTV0P2BASE::getHoursLT())) { return(true); }
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
+  return(Scheduler.isAnyScheduleOnWARMNow());
+  }
+void windowOpenTick()
+  {
+  // Hold the last good value over a sensor error; a reading held between adaptive samples is still the latest.
+  const int16_t tC16 = TemperatureC16.get();
+  if(!TemperatureC16.isErrorValue(tC16)) { windowOpenSample(tC16); }
+  const int16_t slope = windowOpenSlopeC16PerH();
+  if(0 == windowOpenM)
+    {
+    if(valveMode.inWarmMode() && (slope <= -WINDOW_OPEN_FALL_C16_PER_H))
+      {
+      windowOpenM = 1;
+      windowOpenKeepWarm = true;
+      windowOpenScheduleWarm = windowOpenIsScheduleWarm();
+      valveMode.setWarmModeDebounced(false);
+      }
+    return;
+    }
+  // The user (or a schedule starting) has chosen WARM or BAKE again: leave them in control.
+  if(valveMode.inWarmMode()) { windowOpenM = 0; return; }
+  // A scheduled WARM period that ends during the hold would have gone to FROST anyway,
+  // whether the WARM on entry came from the schedule or was manual.
+  const bool scheduleWarm = windowOpenIsScheduleWarm();
+  if(windowOpenScheduleWarm && !scheduleWarm) { windowOpenKeepWarm = false; }
+  windowOpenScheduleWarm = scheduleWarm;
+  // Stop holding once no longer falling (after a minimum hold), or after the maximum,
+  // and resume WARM only if it would still be in force.
+  if(((windowOpenM >= WINDOW_OPEN_MIN_M) && (slope >= 0)) || (windowOpenM >= WINDOW_OPEN_MAX_M))
+    {
+    if(windowOpenKeepWarm || scheduleWarm) { valveMode.setWarmModeDebounced(true); }
+    windowOpenM = 0;
+    }
+  else { ++windowOpenM; }
+  }
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
+
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+static_assert(WEEKLY_SCHEDULE_BYTES == V0P2_EE_LEN_WEEKLY_SCHEDULE, "weekly schedule EEPROM size mismatch");
+uint8_t weeklyScheduleDayOfWeek()
+  {
+  const uint8_t adjust = eeprom_read_byte((uint8_t *)V0P2_EE_START_WEEKLY_DOW_ADJUST);
+  // Day 0 of the RTC, 2000/01/01, was a Saturday.
+  return((uint8_t)((OTV0P2BASE::getDaysSince1999LT() + 5 + ((adjust < 7) ? adjust : 0)) % 7));
+  }
+bool weeklyScheduleIsWarm(const uint8_t dow, const uint8_t hour)
+  {
+  const uint8_t b = eeprom_read_byte((uint8_t *)(V0P2_EE_START_WEEKLY_SCHEDULE + (dow * WEEKLY_SCHEDULE_BYTES_PER_DAY) + (hour >> 3)));
+  return(0 == (b & (1 << (hour & 7)))); // Stored inverted.
+  }
+static constexpr uint8_t WEEKLY_SCHEDULE_HOURS = 7 * 24;
+// Hour of the week (dow*24 + hour) for which weeklyNextWarmHours is valid; 0xff if it must be recomputed.
+static uint8_t weeklyNextWarmAt = 0xff;
+// Hours from weeklyNextWarmAt to the start of the next WARM slot: 0 if in one, 0xff if there are none.
+static uint8_t weeklyNextWarmHours;
+uint16_t weeklyScheduleMinutesToWarm()
+  {
+  const uint8_t dow = weeklyScheduleDayOfWeek();
+  const uint8_t hour = OTV0P2BASE::getHoursLT();
+  const uint8_t now = (dow * 24) + hour;
+  if(now != weeklyNextWarmAt)
+    {
+    // Look ahead hour by hour, at most one week.
+    weeklyNextWarmAt = now;
+    weeklyNextWarmHours = 0xff;
+    uint8_t d = dow, h = hour;
+    for(uint8_t i = 0; i < WEEKLY_SCHEDULE_HOURS; ++i)
+      {
+      if(weeklyScheduleIsWarm(d, h)) { weeklyNextWarmHours = i; break; }
+      if(++h >= 24) { h = 0; if(++d >= 7) { d = 0; } }
+      }
+    }
+  if(0xff == weeklyNextWarmHours) { return(~0); }
+  if(0 == weeklyNextWarmHours) { return(0); }
+  return((weeklyNextWarmHours * 60U) - OTV0P2BASE::getMinutesLT());
+  }
+void weeklyScheduleGetDay(const uint8_t dow, uint8_t bits[WEEKLY_SCHEDULE_BYTES_PER_DAY])
+  {
+  for(uint8_t i = 0; i < WEEKLY_SCHEDULE_BYTES_PER_DAY; ++i)
+    { bits[i] = ~eeprom_read_byte((uint8_t *)(V0P2_EE_START_WEEKLY_SCHEDULE + (dow * WEEKLY_SCHEDULE_BYTES_PER_DAY) + i)); }
+  }
+void weeklyScheduleSetDay(const uint8_t dow, const uint8_t bits[WEEKLY_SCHEDULE_BYTES_PER_DAY])
+  {
+  for(uint8_t i = 0; i < WEEKLY_SCHEDULE_BYTES_PER_DAY; ++i)
+    { OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)(V0P2_EE_START_WEEKLY_SCHEDULE + (dow * WEEKLY_SCHEDULE_BYTES_PER_DAY) + i), ~bits[i]); }
+  weeklyNextWarmAt = 0xff;
+  }
+void weeklyScheduleSetDayOfWeek(const uint8_t dow)
+  {
+  const uint8_t rtcDow = (uint8_t)((OTV0P2BASE::getDaysSince1999LT() + 5) % 7);
+  OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)V0P2_EE_START_WEEKLY_DOW_ADJUST, (dow + 7 - rtcDow) % 7);
+  weeklyNextWarmAt = 0xff;
+  }
+// State of the current slot when last applied: 0/1, or 0xff if not yet known (eg just after power-up).
+static uint8_t weeklyLastWarm = 0xff;
+void weeklyScheduleApply()
+  {
+  const uint8_t warm = weeklyScheduleIsWarm(weeklyScheduleDayOfWeek(), OTV0P2BASE::getHoursLT()) ? 1 : 0;
+  if(warm != weeklyLastWarm)
+    {
+    // At power-up only switch on, not off, to avoid overriding a mode just set by other means.
+    if(warm) { valveMode.setWarmModeDebounced(true); }
+    else if(0xff != weeklyLastWarm) { valveMode.setWarmModeDebounced(false); }
+    weeklyLastWarm = warm;
+    }
+  }
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
+
+#if defined(ENABLE_PREDICTIVE_PREHEAT)
+// Safety margin (minutes) added to the predicted warm-up time.
+#ifndef PREHEAT_MARGIN_M
+#define PREHEAT_MARGIN_M 10
+#endif
+// Longest pre-heat lead (minutes) ever used, whatever the prediction.
+#ifndef PREHEAT_MAX_LEAD_M
+#define PREHEAT_MAX_LEAD_M 240
+#endif
+// Minimum rise (C16) to target for a warm-up to be worth timing or predicting.
+static constexpr uint8_t PREHEAT_MIN_RISE_C16 = 16;
+// Start-temperature band for the given room temperature: <12C, <16C, <19C, else warmer.
+static uint8_t preheatBand(const int16_t tempC16)
+  { return((tempC16 < 12*16) ? 0 : ((tempC16 < 16*16) ? 1 : ((tempC16 < 19*16) ? 2 : 3))); }
+static_assert(PREHEAT_RATE_BANDS <= V0P2_EE_LEN_PREHEAT_RATE, "too many pre-heat bands for EEPROM");
+// Learned rate for band; 0xff if not yet learned.
+static uint8_t preheatRate(const uint8_t band) { return(eeprom_read_byte((uint8_t *)(V0P2_EE_START_PREHEAT_RATE + band))); }
+uint8_t getPreheatRateC16PerH() { return(preheatRate(preheatBand(TemperatureC16.get()))); }
+// Warm-up currently being timed: start temperature and minutes elapsed; not timing if preheatTimingM is 0.
+static int16_t preheatStartC16;
+static uint8_t preheatTimingM;
+static bool preheatWasWarm;
+void predictivePreheat()
+  {
+  const int16_t tempC16 = TemperatureC16.get();
+  const int16_t targetC16 = ((int16_t)tempControl.getWARMTargetC()) << 4;
+  const bool warm = valveMode.inWarmMode();
+  // Start timing a warm-up on entry to WARM well below target.
+  if(warm && !preheatWasWarm && (tempC16 + PREHEAT_MIN_RISE_C16 <= targetC16))
+    { preheatStartC16 = tempC16; preheatTimingM = 1; }
+  preheatWasWarm = warm;
+  if(0 != preheatTimingM)
+    {
+    // Abandon if WARM is cancelled before target is reached.
+    if(!warm) { preheatTimingM = 0; }
+    // On reaching target, or giving up on a very slow room, fold the observed rate into the band's average.
+    else if((tempC16 >= targetC16) || (255 == preheatTimingM))
+      {
+      const uint8_t band = preheatBand(preheatStartC16);
+      const int16_t rise = OTV0P2BASE::fnmax((int16_t)0, (int16_t)(tempC16 - preheatStartC16));
+      const uint8_t rate = (uint8_t)OTV0P2BASE::fnmin(OTV0P2BASE::fnmax((rise * 60L) / preheatTimingM, 1L), 254L);
+      const uint8_t old = preheatRate(band);
+      const uint8_t updated = (0xff == old) ? rate : (uint8_t)(((3 * (uint16_t)old) + rate + 2) / 4);
+      OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)(V0P2_EE_START_PREHEAT_RATE + band), updated);
+      preheatTimingM = 0;
+      }
+    else { ++preheatTimingM; }
+    return;
+    }
+  if(warm) { return; }
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+  if(isWindowOpen()) { return; } // Don't fight the window-open setback.
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
+  // Not yet WARM: switch to it early if a scheduled period would otherwise start too late to reach target.
+  if(tempC16 + PREHEAT_MIN_RISE_C16 > targetC16) { return; }
+  const uint8_t rate = preheatRate(preheatBand(tempC16));
+  if(0xff == rate) { return; } // Not learned yet: leave to the fixed schedule pre-warm.
+  const uint16_t leadM = OTV0P2BASE::fnmin((uint16_t)PREHEAT_MAX_LEAD_M,
+      (uint16_t)((((targetC16 - tempC16) * 60L) + rate - 1) / rate + PREHEAT_MARGIN_M));
+  const uint_least16_t now = OTV0P2BASE::getMinutesSinceMidnightLT();
+  for(uint8_t i = 0; i < Scheduler_t::MAX_SIMPLE_SCHEDULES; ++i)
+    {
+    const uint_least16_t on = Scheduler.getSimpleScheduleOn(i);
+    if(on >= OTV0P2BASE::MINS_PER_DAY) { continue; }
+    // Minutes until the user's nominal start time, after the schedule's own fixed pre-warm.
+    const uint16_t untilM = (on + Scheduler_t::PREWARM_MINS + OTV0P2BASE::MINS_PER_DAY - now) % OTV0P2BASE::MINS_PER_DAY;
+    // Only ever start earlier than the schedule would on its own.
+    if((untilM <= leadM) && (untilM > Scheduler_t::PREWARM_MINS))
+      { valveMode.setWarmModeDebounced(true); return; }
+    }
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+  // Weekly schedule slots have no fixed pre-warm of their own.
+  const uint16_t weeklyM = weeklyScheduleMinutesToWarm();
+  if((0 != weeklyM) && (weeklyM <= leadM)) { valveMode.setWarmModeDebounced(true); }
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
   }
+#endif // defined(ENABLE_PREDICTIVE_PREHEAT)
+
+#if defined(ENABLE_VALVE_FITTED_CACHE)
+// CRC over the valve-fitted state byte; never 0, so never matches erased EEPROM with the state byte.
+static uint8_t valveFittedCacheCRC(const uint8_t state) { return(OTV0P2BASE::crc7_5B_update_nz_final(0, state)); }
+// True if EEPROM holds a valid record that the direct-drive valve has been fitted and run normally.
+static bool valveFittedCacheGet()
+  {
+  const uint8_t state = eeprom_read_byte((uint8_t *)V0P2_EE_START_VALVE_FITTED);
+  return((1 == state) && (valveFittedCacheCRC(state) == eeprom_read_byte((uint8_t *)(V0P2_EE_START_VALVE_FITTED + 1))));
+  }
+// Record whether the valve has been fitted; writes EEPROM only on a change.
+static void valveFittedCacheSet(const bool fitted)
+  {
+  if(fitted == valveFittedCacheGet()) { return; }
+  const uint8_t state = fitted ? 1 : 0;
+  OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)V0P2_EE_START_VALVE_FITTED, state);
+  OTV0P2BASE::eeprom_smart_update_byte((uint8_t *)(V0P2_EE_START_VALVE_FITTED + 1), valveFittedCacheCRC(state));
+  }
+#endif // defined(ENABLE_VALVE_FITTED_CACHE)
 
 // Run tasks needed at the end of each hour.
 // Should be run once at a fixed slot in the last minute of each hour.
 // Will be run after all stats for the current hour have been updated.
 static void endOfHourTasks()
   {
+#if defined(ENABLE_MOULD_RISK_MODE)
+  mouldRiskEndOfHour();
+#endif
+#if defined(ENABLE_ENERGY_LEDGER)
+  energyLedgerEndOfHour();
+#endif
+#if defined(ENABLE_ENTROPY_POOL)
+  entropyHealthFailures = 0;
+#endif
+#if defined(ENABLE_TASK_BUDGETS)
+  // Start a new hour of task overrun counts.
+  memset(taskOverruns, 0, sizeof(taskOverruns));
+#endif
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+  idleCyclesSkipped = 0;
+#endif
+#if defined(ENABLE_ISR_EVENT_RING)
+  isrEventMaxLatency = 0;
+#endif
+#ifdef ENABLE_RADIO_SECONDARY_MODULE
+  // Start a new peak secondary radio poll time measurement.
+  secondaryRadioPollMaxTicks = 0;
+#endif
   }
 
 // Run tasks needed at the end of each day (nominal midnight).
@@ -553,6 +1995,78 @@ static uint_fast8_t TIME_LSD;
 // Wraps at its maximum (0xff) value.
 static uint8_t minuteCount;
 
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+// Minutes that a slot allocation remains valid after the last hub beacon heard; strictly positive.
+// Long enough to survive a few missed beacons, since only every 8th is listened for.
+static constexpr uint8_t TX_SLOT_VALID_M = 32;
+// Stats TX slot [0,TX_SLOT_MAX_SLOTS-1] allocated by the hub; only meaningful while txSlotValidM is non-zero.
+static uint8_t txSlot;
+// Minutes left before the slot allocation expires; zero if none is valid.
+static uint8_t txSlotValidM;
+// Local second in which the hub beacon is expected.
+static uint8_t txSlotBeaconSecond = TX_SLOT_BEACON_SECOND;
+// Sub-cycle time in each local minor cycle at which the matching hub minor cycle starts.
+static uint8_t txSlotPhaseSCT;
+// Local second in which to listen next while searching for a hub beacon.
+static uint8_t txSlotSearchSecond;
+// Seconds [0,TIME_CYCLE_S-1] to add to the local second (mod TIME_CYCLE_S) to get the hub's.
+// The local RTC is never moved to match the hub, so no once-per-minute work is skipped or repeated.
+static uint8_t txSlotOffsetS;
+
+// Called with the slot allocated to this node by an authenticated hub beacon.
+// The beacon is sent at the start of the hub's TX_SLOT_BEACON_SECOND,
+// so the local second in which it was picked up corresponds to that hub second.
+// If the beacon arrived late in the local minor cycle then the hub's minor cycles
+// mostly overlap the following local ones, so the offset is one minor cycle less
+// and TX is at the start of the local cycle, to stay well inside the hub's slot.
+void txSlotAllocationRX(const uint8_t slot, const uint8_t rxSeconds, const uint8_t rxSCT)
+  {
+  if(slot >= TX_SLOT_MAX_SLOTS) { return; }
+  const bool late = (rxSCT > (OTV0P2BASE::GSCT_MAX/2));
+  const uint8_t target = late ? (TX_SLOT_BEACON_SECOND - 2) : TX_SLOT_BEACON_SECOND;
+  txSlot = slot;
+  txSlotValidM = TX_SLOT_VALID_M;
+  // Decryption may have carried processing into a later minor cycle, so use the second at RX.
+  txSlotBeaconSecond = rxSeconds;
+  txSlotOffsetS = (TIME_CYCLE_S + target - rxSeconds) % TIME_CYCLE_S;
+  txSlotPhaseSCT = late ? 0 : rxSCT;
+  }
+
+// True if this leaf has a valid hub-allocated stats TX slot overlapping the minor cycle starting at the given local second.
+// The hub's slot seconds run from 8 to 22, as for randomly-chosen slots.
+static bool txSlotStatsTXDue(const uint8_t seconds)
+  {
+  if((0 == txSlotValidM) || inHubMode()) { return(false); }
+  return(((seconds + txSlotOffsetS) % TIME_CYCLE_S) == (8 + 2*txSlot));
+  }
+
+// True if this leaf should listen for the hub beacon in the minor cycle starting at the given second.
+// While tracking, listen only for the expected beacon once every 8 minutes.
+// While searching, listen for one minor cycle every 8 minutes, stepping through the minute,
+// to keep the energy cost of searching for an absent hub low.
+static bool txSlotListenFor(const uint8_t seconds)
+  {
+  if(0 != (minuteCount & 7)) { return(false); }
+  return(seconds == ((0 != txSlotValidM) ? txSlotBeaconSecond : txSlotSearchSecond));
+  }
+
+// Fill in the hub beacon body: leading ID bytes of the associated nodes in slot order.
+// Returns the body length, zero if there are no associations.
+static uint8_t txSlotAllocationBody(uint8_t *const body)
+  {
+  const uint8_t n = OTV0P2BASE::fnmin(OTV0P2BASE::countNodeAssociations(), TX_SLOT_MAX_SLOTS);
+  uint8_t id[OTV0P2BASE::OpenTRV_Node_ID_Bytes];
+  uint8_t bl = 0;
+  for(uint8_t i = 0; i < n; ++i)
+    {
+    if(!OTV0P2BASE::getNodeAssociation(i, id)) { break; }
+    memcpy(body + bl, id, TX_SLOT_ID_PREFIX_BYTES);
+    bl += TX_SLOT_ID_PREFIX_BYTES;
+    }
+  return(bl);
+  }
+#endif // defined(ENABLE_TX_SLOT_ALLOCATION)
+
 // Mask for Port B input change interrupts.
 #define MASK_PB_BASIC 0b00000000 // Nothing.
 #if defined(PIN_RFM_NIRQ) && defined(ENABLE_RADIO_RX) // RFM23B IRQ only used for RX.
@@ -590,6 +2104,56 @@ static uint8_t minuteCount;
   #define MASK_PD MASK_PD1 // No MODE button interrupt.
 #endif
 
+#if defined(ENABLE_STATS_TX) && defined(ENABLE_FAST_BOOT)
+// Maximum wake-up stats frames to send after boot: binary, then JSON until no changed values remain.
+static constexpr uint8_t BOOT_STATS_TX_FRAMES = 5;
+// Wake-up stats frames still to send, one per minor cycle from the main loop.
+static uint8_t bootStatsTXPending;
+#endif
+
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+// True if the per-cycle work (UI, valve motor, FHT8V, CLI, wake-up stats) is idle.
+static bool idlePerCycleWorkIdle()
+  {
+#if defined(ENABLE_FHT8VSIMPLE)
+  if(localFHT8VTRVEnabled()) { return(false); }
+#endif
+#if defined(valveUI_DEFINED)
+  if(valveUI.veryRecentUIControlUse()) { return(false); }
+#endif
+#if defined(ENABLE_CLI)
+  if(OTV0P2BASE::CLI::isCLIActive()) { return(false); }
+#endif
+#if defined(HAS_DORM1_VALVE_DRIVE) && defined(ENABLE_LOCAL_TRV)
+  // The motor is driven a little in each minor cycle until the valve reaches its target.
+  if(!ValveDirect.isInNormalRunState() || (ValveDirect.get() != NominalRadValve.get())) { return(false); }
+#endif
+#if defined(ENABLE_STATS_TX) && defined(ENABLE_FAST_BOOT)
+  if(0 != bootStatsTXPending) { return(false); }
+#endif
+  return(true);
+  }
+// Called from the sleep loop when the RTC starts a new minor cycle at the given second.
+// If no work is due in it then adopts it as the current cycle and returns true to keep sleeping.
+// The RTC tick still wakes the CPU briefly, but the main loop body is not run.
+static bool idleCycleSkip(const uint8_t second)
+  {
+  if(!idleSkipOK || (second == idleWakeS)) { return(false); }
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+  // The cycle before a beacon listen sets up the radio, and the listen cycle turns it off again.
+  if(txSlotStatsTXDue(second) || txSlotListenFor(second) || txSlotListenFor((second + 2) % TIME_CYCLE_S)) { return(false); }
+#endif
+  TIME_LSD = second;
+  ++idleCyclesSkipped;
+#if defined(ENABLE_WATCHDOG_SLOW)
+  // Reset and immediately re-prime the RTC-based watchdog, as at the start of each cycle run.
+  OTV0P2BASE::resetRTCWatchDog();
+  OTV0P2BASE::enableRTCWatchdog(true);
+#endif
+  return(true);
+  }
+#endif // defined(ENABLE_IDLE_CYCLE_SKIP)
+
 void setupOpenTRV()
   {
 #if 0 && defined(DEBUG)
@@ -604,6 +2168,16 @@ void setupOpenTRV()
   DEBUG_SERIAL_PRINTLN_FLASHSTRING("PrimaryRadio.listen(false);");
 #endif
 
+#if defined(ENABLE_VALVE_FITTED_CACHE)
+  // A power-on reset (eg a battery change) may mean that the head was taken off and is not yet refitted,
+  // so forget that the valve was fitted and wait for the fitter (or the usual timeout) again.
+  // If the bootloader has already cleared the reset flags then the cause is unknown, so do the same.
+  // Clear the flags so that the cause of the next reset can be told.
+  const uint8_t mcusr = MCUSR;
+  MCUSR = 0;
+  if((0 == mcusr) || (0 != (mcusr & _BV(PORF)))) { valveFittedCacheSet(false); }
+#endif // defined(ENABLE_VALVE_FITTED_CACHE)
+
   // Set up async edge interrupts.
   ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
     {
@@ -644,7 +2218,10 @@ void setupOpenTRV()
   // Initialise sensors with stats info where needed.
   updateSensorsFromStats();
 
-#ifdef ENABLE_STATS_TX
+#if defined(ENABLE_STATS_TX) && defined(ENABLE_FAST_BOOT)
+  // Leave the early 'wake-up' stats transmission to the main loop.
+  if(enableTrailingStatsPayload()) { bootStatsTXPending = BOOT_STATS_TX_FRAMES; }
+#elif defined(ENABLE_STATS_TX)
   // Do early 'wake-up' stats transmission if possible
   // when everything else is set up and ready and allowed (TODO-636)
   // including all set-up and inter-wiring of sensors/actuators.
@@ -750,7 +2327,11 @@ ISR(PCINT2_vect)
 #if defined(ENABLE_SIMPLIFIED_MODE_BAKE)
   // Mode button detection is on the falling edge (button pressed).
   if((changes & MODE_INT_MASK) && !(pins & MODE_INT_MASK))
+#if defined(ENABLE_ISR_EVENT_RING)
+    { isrEvents.push(ISR_EVENT_BAKE); }
+#else
     { valveUI.startBakeFromInt(); }
+#endif
 #endif // defined(ENABLE_SIMPLIFIED_MODE_BAKE)
 
 #if defined(ENABLE_VOICE_SENSOR)
@@ -762,7 +2343,11 @@ ISR(PCINT2_vect)
   // Handler routine not required/expected to 'clear' this interrupt.
   // FIXME: ensure that Voice.handleInterruptSimple() is inlineable to minimise ISR prologue/epilogue time and space.
   if((changes & VOICE_INT_MASK) && (pins & VOICE_INT_MASK))
+#if defined(ENABLE_ISR_EVENT_RING)
+    { isrEvents.push(ISR_EVENT_VOICE); }
+#else
     { Voice.handleInterruptSimple(); }
+#endif
 #endif // defined(ENABLE_VOICE_SENSOR)
 
   // If an interrupt arrived from the serial RX then wake up the CLI.
@@ -771,7 +2356,11 @@ ISR(PCINT2_vect)
   // It is OK to trigger this from other things such as button presses.
   // TODO: ensure that resetCLIActiveTimer() is inlineable to minimise ISR prologue/epilogue time and space.
   if((changes & SERIALRX_INT_MASK) && !(pins & SERIALRX_INT_MASK))
+#if defined(ENABLE_ISR_EVENT_RING)
+    { isrEvents.push(ISR_EVENT_SERIAL_RX); }
+#else
     { OTV0P2BASE::CLI::resetCLIActiveTimer(); }
+#endif
   }
 #endif
 
@@ -789,6 +2378,73 @@ static bool isBoilerOn() { return(0 != boilerCountdownTicks); }
 // Does not roll once at its maximum value (255).
 // DHD20160124: starting at zero forces at least for off time after power-up before firing up boiler (good after power-cut).
 static uint8_t boilerNoCallM;
+// Recent boiler cycles, each an on period and the off period before it, in minutes (saturating).
+// Used to lengthen the minimum on and off times while the boiler is short-cycling.
+#ifndef BOILER_CYCLE_HISTORY
+#define BOILER_CYCLE_HISTORY 8
+#endif
+// Shortest whole cycle (on plus off, minutes) not counted as short-cycling.
+#ifndef BOILER_CYCLE_TARGET_M
+#define BOILER_CYCLE_TARGET_M 20
+#endif
+// Most minutes ever added to the configured minimum on/off times.
+#ifndef BOILER_CYCLE_MAX_EXTRA_M
+#define BOILER_CYCLE_MAX_EXTRA_M 15
+#endif
+static uint8_t boilerCycleOnM[BOILER_CYCLE_HISTORY];
+static uint8_t boilerCycleOffM[BOILER_CYCLE_HISTORY];
+// Next slot to write in the cycle history.
+static uint8_t boilerCycleNext;
+// Minutes in the current on or off state, and length of the last completed on period.
+static uint8_t boilerStateM;
+static uint8_t boilerLastOnM;
+static uint8_t boilerExtraM;
+static uint8_t boilerCycleExtraM() { return(boilerExtraM); }
+// Cycles started and minutes on so far this hour, and the results for the last complete hour.
+static uint8_t boilerHourM;
+static uint8_t boilerHourCycles;
+static uint8_t boilerHourOnM;
+static uint8_t boilerLastHourCycles;
+static uint8_t boilerLastHourOnM;
+static uint8_t boilerCyclesPerHour() { return(boilerLastHourCycles); }
+static uint8_t boilerDutyPC() { return((uint8_t)((boilerLastHourOnM * 100U) / 60)); }
+// Note a boiler on/off transition, and on switch-on record the cycle just completed
+// and recompute how much to extend minimum on/off times from the mean recent cycle length.
+static void boilerCycleEdge(const bool nowOn)
+  {
+  if(!nowOn) { boilerLastOnM = boilerStateM; boilerStateM = 0; return; }
+  boilerCycleOnM[boilerCycleNext] = boilerLastOnM;
+  boilerCycleOffM[boilerCycleNext] = boilerStateM;
+  boilerCycleNext = (boilerCycleNext + 1) % BOILER_CYCLE_HISTORY;
+  boilerStateM = 0;
+  if(boilerHourCycles < 255) { ++boilerHourCycles; }
+  uint16_t total = 0;
+  uint8_t n = 0;
+  for(uint8_t i = 0; i < BOILER_CYCLE_HISTORY; ++i)
+    {
+    const uint8_t len = OTV0P2BASE::fnmin(255U, (unsigned)boilerCycleOnM[i] + boilerCycleOffM[i]);
+    if(0 != len) { total += len; ++n; }
+    }
+  // Wait for some history; then extend by half the shortfall from the target cycle length.
+  const uint16_t mean = (n >= BOILER_CYCLE_HISTORY/2) ? (total / n) : BOILER_CYCLE_TARGET_M;
+  boilerExtraM = (mean >= BOILER_CYCLE_TARGET_M) ? 0 :
+      (uint8_t)OTV0P2BASE::fnmin((uint16_t)BOILER_CYCLE_MAX_EXTRA_M, (uint16_t)((BOILER_CYCLE_TARGET_M - mean) / 2));
+  }
+// Count minutes in the current boiler state and roll up hourly cycle stats; call once per minute.
+static void boilerCycleMinute(const bool on)
+  {
+  if(boilerStateM < 255) { ++boilerStateM; }
+  if(on) { ++boilerHourOnM; }
+  if(++boilerHourM >= 60)
+    {
+    boilerLastHourCycles = boilerHourCycles;
+    boilerLastHourOnM = boilerHourOnM;
+    boilerHourM = 0;
+    boilerHourCycles = 0;
+    boilerHourOnM = 0;
+    }
+  }
+
 // Reducing listening if quiet for a while helps reduce self-heating temperature error
 // (~2C as of 2013/12/24 at 100% RX, ~100mW heat dissipation in V0.2 REV1 box) and saves some energy.
 // Time thresholds could be affected by eco/comfort switch.
@@ -796,6 +2452,7 @@ static uint8_t boilerNoCallM;
 // IF DEFINED then give backoff threshold to minimise duty cycle.
 //#define RX_REDUCE_MAX_M 240 // Minutes quiet before considering maximally reducing RX duty cycle; ]RX_REDUCE_MIN_M--255], 30--240 typical.
 
+#if !defined(ENABLE_ISR_EVENT_RING) // Else queued in cfhEvents.
 // Set true on receipt of plausible call for heat,
 // to be polled, evaluated and cleared by the main control routine.
 // Marked volatile to allow thread-safe lock-free access.
@@ -804,6 +2461,66 @@ static volatile bool receivedCallForHeat;
 // Marked volatile to allow access from an ISR,
 // but note that access may only be safe with interrupts disabled as not a byte value.
 static volatile uint16_t receivedCallForHeatID;
+#endif
+
+// Maximum number of valves individually tracked by the hub.
+// When full the stalest entry is reused.
+#ifndef HUB_DEMAND_MAX_VALVES
+#define HUB_DEMAND_MAX_VALVES 8
+#endif
+// Minutes without hearing from a valve after which it is dropped from the demand table.
+// Valves normally report every few minutes.
+#ifndef HUB_DEMAND_TIMEOUT_M
+#define HUB_DEMAND_TIMEOUT_M 15
+#endif
+// Extra %-open above the minimum really-open level that a valve must reach to start calling for heat,
+// so that one valve hovering around that level does not repeatedly start the boiler.
+#ifndef HUB_DEMAND_HYSTERESIS_PC
+#define HUB_DEMAND_HYSTERESIS_PC 5
+#endif
+// Latest demand from one valve, keyed by node ID prefix, FHT8V house code or ~0 for the local valve.
+struct HubValveDemand
+  {
+  uint16_t id;
+  // Last reported %-open [0,100].
+  uint8_t percentOpen;
+  // Minutes since last heard from, plus one; 0 if the entry is unused.
+  uint8_t ageM;
+  // True while this valve counts towards aggregate demand.
+  bool calling;
+  };
+static HubValveDemand hubDemand[HUB_DEMAND_MAX_VALVES];
+static uint8_t hubDemandValves(const bool callingOnly)
+  {
+  uint8_t n = 0;
+  for(const HubValveDemand &d : hubDemand) { if((0 != d.ageM) && (!callingOnly || d.calling)) { ++n; } }
+  return(n);
+  }
+static uint8_t hubDemandAggregatePC()
+  {
+  uint16_t sum = 0;
+  for(const HubValveDemand &d : hubDemand) { if((0 != d.ageM) && d.calling) { sum += d.percentOpen; } }
+  return((uint8_t)OTV0P2BASE::fnmin(sum, (uint16_t)255));
+  }
+// Age demand table entries, dropping valves not heard from for too long; call once per minute.
+static void hubDemandAgeM()
+  {
+  for(HubValveDemand &d : hubDemand)
+    { if((0 != d.ageM) && (++d.ageM > HUB_DEMAND_TIMEOUT_M + 1)) { d.ageM = 0; d.calling = false; } }
+  }
+// Find the entry for the given valve, else a free one, else the stalest; never NULL.
+static HubValveDemand *hubDemandEntry(const uint16_t id)
+  {
+  HubValveDemand *victim = hubDemand;
+  for(HubValveDemand &d : hubDemand)
+    {
+    if((0 != d.ageM) && (id == d.id)) { return(&d); }
+    if((0 != victim->ageM) && ((0 == d.ageM) || (d.ageM > victim->ageM))) { victim = &d; }
+    }
+  victim->id = id;
+  victim->calling = false;
+  return(victim);
+  }
 
 // Raw notification of received call for heat from remote (eg FHT8V) unit.
 // This form has a 16-bit ID (eg FHT8V housecode) and percent-open value [0,100].
@@ -813,9 +2530,8 @@ static volatile uint16_t receivedCallForHeatID;
 // Does not have to be thread-/ISR- safe.
 void remoteCallForHeatRX(const uint16_t id, const uint8_t percentOpen)
   {
-  // TODO: Should be filtering first by housecode
-  // then by individual and tracked aggregate valve-open percentage.
-  // Only individual valve levels used here; no state is retained.
+  // TODO: Should be filtering first by housecode.
+  // Each valve's latest level is tracked individually, and the boiler is driven by their aggregate.
 
   // Normal minimum single-valve percentage open that is not ignored.
   // Somewhat higher than typical per-valve minimum,
@@ -862,11 +2578,26 @@ void remoteCallForHeatRX(const uint16_t id, const uint8_t percentOpen)
   const uint8_t threshold = (!considerPause && (encourageOn || isBoilerOn())) ?
       minvro : OTV0P2BASE::fnmax(minvro, (uint8_t) (OTRadValve::DEFAULT_VALVE_PC_MODERATELY_OPEN-1));
 
-  if(percentOpen >= threshold)
+  // Update this valve's entry, with hysteresis on whether it is calling for heat.
+  // During a pause only valves at least moderately open count at all.
+  HubValveDemand *const e = hubDemandEntry(id);
+  e->percentOpen = percentOpen;
+  e->ageM = 1;
+  const uint8_t minToCall = considerPause ? threshold :
+      (e->calling ? minvro : OTV0P2BASE::fnmin((uint8_t)100, (uint8_t)(minvro + HUB_DEMAND_HYSTERESIS_PC)));
+  e->calling = (percentOpen >= minToCall);
+
+  // Start (or keep) the boiler running when calling valves in aggregate reach the threshold,
+  // so that several partly-open valves can together do what one moderately-open valve would.
+  if(e->calling && (hubDemandAggregatePC() >= threshold))
     // && FHT8VHubAcceptedHouseCode(command.hc1, command.hc2))) // Accept if house code OK.
     {
+#if defined(ENABLE_ISR_EVENT_RING)
+    cfhEvents.push(ISR_EVENT_CALL_FOR_HEAT, id);
+#else
     receivedCallForHeat = true; // FIXME
     receivedCallForHeatID = id;
+#endif
     }
   }
 #endif
@@ -958,6 +2689,23 @@ static bool setUpContinuousRX()
   }
 #endif // defined(ENABLE_RADIO_RX)
 
+#if defined(ENABLE_BOILER_HUB)
+// Log a received call for heat from the given caller ID.
+static void logCallForHeat(const uint16_t hcRequest)
+  {
+//  // Don't log call for hear if near overrun,
+//  // and leave any error queued for next time.
+//  if(OTV0P2BASE::getSubCycleTime() >= nearOverrunThreshold) { return; } // { tooNearOverrun = true; }
+//  DEBUG_SERIAL_TIMESTAMP();
+//  DEBUG_SERIAL_PRINT(' ');
+  OTV0P2BASE::serialPrintAndFlush(F("CfH ")); // Call for heat from
+  OTV0P2BASE::serialPrintAndFlush((hcRequest >> 8) & 0xff);
+  OTV0P2BASE::serialPrintAndFlush(' ');
+  OTV0P2BASE::serialPrintAndFlush(hcRequest & 0xff);
+  OTV0P2BASE::serialPrintlnAndFlush();
+  }
+#endif // defined(ENABLE_BOILER_HUB)
+
 // Process calls for heat, ie turn boiler on and off as appropriate.
 // Has control of OUT_HEATCALL if defined(ENABLE_BOILER_HUB).
 static void processCallsForHeat(const bool second0)
@@ -965,6 +2713,18 @@ static void processCallsForHeat(const bool second0)
 #if defined(ENABLE_BOILER_HUB)
   if(inHubMode())
     {
+    const bool wasOn = isBoilerOn();
+#if defined(ENABLE_ISR_EVENT_RING)
+    // Take all queued calls for heat, logging each caller.
+    bool heardIt = false;
+    ISREvent e;
+    while(cfhEvents.pop(e))
+      {
+      isrEventHandled(e);
+      heardIt = true;
+      logCallForHeat(e.arg);
+      }
+#else
     // Check if call-for-heat has been received, and clear the flag.
     bool _h;
     uint16_t _hID; // Only valid if _h is true.
@@ -978,31 +2738,16 @@ static void processCallsForHeat(const bool second0)
         }
       }
     const bool heardIt = _h;
-    const uint16_t hcRequest = heardIt ? _hID : 0; // Only valid if heardIt is true.
-    
-//    // Don't log call for hear if near overrun,
-//    // and leave any error queued for next time.
-//    if(OTV0P2BASE::getSubCycleTime() >= nearOverrunThreshold) { } // { tooNearOverrun = true; }
-//    else
-      {
-      if(heardIt)
-        {
-//        DEBUG_SERIAL_TIMESTAMP();
-//        DEBUG_SERIAL_PRINT(' ');
-        OTV0P2BASE::serialPrintAndFlush(F("CfH ")); // Call for heat from
-        OTV0P2BASE::serialPrintAndFlush((hcRequest >> 8) & 0xff);
-        OTV0P2BASE::serialPrintAndFlush(' ');
-        OTV0P2BASE::serialPrintAndFlush(hcRequest & 0xff);
-        OTV0P2BASE::serialPrintlnAndFlush();
-        }
-      }
+    if(heardIt) { logCallForHeat(_hID); }
+#endif
 
     // Record call for heat, both to start boiler-on cycle and possibly to defer need to listen again.
     // Ignore new calls for heat until minimum off/quiet period has been reached.
     // Possible optimisation: may be able to stop RX if boiler is on for local demand (can measure local temp better: less self-heating) and not collecting stats.
     if(heardIt)
       {
-      const uint8_t minOnMins = getMinBoilerOnMinutes();
+      // Configured minimum, extended while short-cycling.
+      const uint8_t minOnMins = (uint8_t)OTV0P2BASE::fnmin(255U, (unsigned)getMinBoilerOnMinutes() + boilerExtraM);
       bool ignoreRCfH = false;
       if(!isBoilerOn())
         {
@@ -1041,6 +2786,12 @@ static void processCallsForHeat(const bool second0)
     // Else boiler is off so count up quiet minutes until at max...
     else if(second0 && (boilerNoCallM < 255))
         { ++boilerNoCallM; }
+    // Age per-valve demand.
+    if(second0) { hubDemandAgeM(); }
+    // Track boiler cycling.
+    const bool nowOn = isBoilerOn();
+    if(nowOn != wasOn) { boilerCycleEdge(nowOn); }
+    if(second0) { boilerCycleMinute(nowOn); }
 
     // Set BOILER_OUT as appropriate for calls for heat.
     // Local calls for heat come via the same route (TODO-607).
@@ -1052,6 +2803,57 @@ static void processCallsForHeat(const bool second0)
   }
 
 
+#if defined(ENABLE_STATS_TX)
+// Send stats in the current minor cycle if this is a stats minute,
+// first waiting (handling I/O) until the sub-cycle time passes stopBy.
+static void statsTXInSlot(const uint8_t stopBy, const uint8_t minuteFrom4, const bool batteryLow)
+  {
+#if !defined(ENABLE_FREQUENT_STATS_TX) // If ENABLE_FREQUENT_STATS_TX then send every minute regardless.
+  // Stats TX in the minute (#1) after all sensors should have been polled
+  // (so that readings are fresh) and evenly between.
+  // Usually send one frame every 4 minutes, 2 if this is a valve.
+  // No extra stats TX for changed data to reduce information/activity leakage.
+  // Note that all O frames contain the current valve percentage,
+  // which implies that any extra stats TX also speeds response to call-for-heat changes.
+#ifdef ENABLE_NOMINAL_RAD_VALVE
+  // DHD20170113: was once every 4 minutes, but can make boiler response too slow.
+  if(0 == (minuteFrom4 & 1)) { return; }
+#else
+  if(1 != minuteFrom4) { return; }
+#endif
+#endif
+
+  // Abort if not allowed to send stats at all.
+  // FIXME: fix this to send bare calls for heat / valve % instead from valves for secure non-FHT8V comms.
+  if(!enableTrailingStatsPayload()) { return; }
+
+  // Wait until stopBy in the minor cycle.
+  while(OTV0P2BASE::getSubCycleTime() <= stopBy)
+    {
+    // Handle any pending I/O while waiting.
+    if(handleQueuedMessages(&Serial, true, &PrimaryRadio)) { continue; }
+    // Sleep a little.
+    OTV0P2BASE::nap(WDTO_15MS, true);
+    }
+
+  // Send stats!
+  // Try for double TX for extra robustness unless:
+  //   * this is a speculative 'extra' TX
+  //   * battery is low
+  //   * this node is a hub so needs to listen as much as possible
+  // This doesn't generally/always need to send binary/both formats
+  // if this is controlling a local FHT8V on which the binary stats can be piggybacked.
+  // Ie, if doesn't have a local TRV then it must send binary some of the time.
+  // Any recently-changed stats value is a hint that a strong transmission might be a good idea.
+#if defined(ENABLE_BINARY_STATS_TX) && defined(ENABLE_FS20_ENCODING_SUPPORT)
+  const bool doBinary = !localFHT8VTRVEnabled() && OTV0P2BASE::randRNG8NextBoolean();
+#else
+  const bool doBinary = false;
+#endif
+  bareStatsTX(!batteryLow && !inHubMode() && ss1.changedValue(), doBinary);
+  }
+#endif // defined(ENABLE_STATS_TX)
+
 // Main loop for OpenTRV radiator control.
 // Note: exiting and re-entering can take a little while, handling Arduino background tasks such as serial.
 void loopOpenTRV()
@@ -1098,6 +2900,10 @@ void loopOpenTRV()
     true; // Allow local power conservation if all other factors are right.
 #endif
 
+  // Only when runAll is true run less-critical tasks that be skipped sometimes when particularly conserving energy.
+  // Run all for first full 4-minute cycle, eg because unit may start anywhere in it.
+  const bool runAll = (!conserveBattery) || minute0From4ForSensors || (minuteCount < 4);
+
   // Try if very near to end of cycle and thus causing an overrun.
   // Conversely, if not true, should have time to safely log outputs, etc.
   const uint8_t nearOverrunThreshold = OTV0P2BASE::GSCT_MAX - 8; // ~64ms/~32 serial TX chars of grace time...
@@ -1107,6 +2913,20 @@ void loopOpenTRV()
 
 #if defined(ENABLE_CONTINUOUS_RX)
   const bool needsToListen = setUpContinuousRX();
+#if defined(ENABLE_ENERGY_LEDGER)
+  if(needsToListen) { ++energyRXCycles; }
+#endif
+#endif
+
+#if defined(ENABLE_TX_SLOT_ALLOCATION) && defined(ENABLE_RADIO_RX) && defined(PIN_RFM_NIRQ)
+  // A leaf listens briefly for hub beacons carrying TX slot allocations.
+  // (A hub is listening anyway.)
+#if defined(ENABLE_CONTINUOUS_RX)
+  if(!needsToListen)
+#else
+  if(!inHubMode())
+#endif
+    { PrimaryRadio.listen(txSlotListenFor((TIME_LSD + 2) % TIME_CYCLE_S)); }
 #endif
 
 #if defined(ENABLE_BOILER_HUB)
@@ -1123,13 +2943,35 @@ void loopOpenTRV()
 #endif
 //  // Ensure that serial I/O is off while sleeping, unless listening with radio.
 //  if(!needsToListen) { powerDownSerial(); } else { powerUpSerialIfDisabled<V0P2_UART_BAUD>(); }
+#if defined(ENABLE_ENERGY_LEDGER)
+  // Count time awake this minor cycle (ignoring brief wake-ups while sleeping for I/O).
+  energyAwakeTicks += OTV0P2BASE::getSubCycleTime();
+#endif
   // Ensure that serial I/O is off while sleeping.
   OTV0P2BASE::powerDownSerial();
   // Power down most stuff (except radio for hub RX).
   OTV0P2BASE::minimisePowerWithoutSleep();
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+  // While conserving battery with the per-cycle work idle,
+  // sleep on through following minor cycles until the next minute task is due.
+  idleSkipOK = conserveBattery && !inHubMode() && idlePerCycleWorkIdle()
+#if defined(ENABLE_CONTINUOUS_RX)
+      && !needsToListen
+#endif
+      ;
+  idleWakeS = minuteTaskNextDue((TIME_LSD + 2) % TIME_CYCLE_S, runAll);
+#endif
   uint_fast8_t newTLSD;
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+  while((TIME_LSD == (newTLSD = OTV0P2BASE::getSecondsLT())) || idleCycleSkip(newTLSD))
+#else
   while(TIME_LSD == (newTLSD = OTV0P2BASE::getSecondsLT()))
+#endif
     {
+#if defined(ENABLE_ISR_EVENT_RING)
+    // Handle events from any interrupt that woke us, before sleeping again.
+    drainISREvents();
+#endif
 #ifdef ENABLE_RADIO_RX
     // Poll I/O and process message incrementally (in this otherwise idle time)
     // before sleep and on wakeup in case some IO needs further processing now,
@@ -1159,10 +3001,21 @@ void loopOpenTRV()
       // Normal long minimal-power sleep until wake-up interrupt.
       // Rely on interrupt to force quick loop round to I/O poll.
       OTV0P2BASE::sleepUntilInt();
+#if defined(ENABLE_IDLE_CYCLE_SKIP)
+      // Woken by something other than the RTC tick, so run the next cycle in full.
+      if(TIME_LSD == OTV0P2BASE::getSecondsLT()) { idleSkipOK = false; }
+#endif
       }
 //    DEBUG_SERIAL_PRINTLN_FLASHSTRING("w"); // Wakeup.
     }
   TIME_LSD = newTLSD;
+#if defined(ENABLE_ISR_EVENT_RING)
+  drainISREvents();
+#endif
+#if defined(ENABLE_ENTROPY_POOL)
+  // CPU timer phase on wake-up from the slow RTC tick has some jitter.
+  entropyPoolAdd(ENTROPY_SRC_JITTER, OTV0P2BASE::getCPUCycleCount(), 1);
+#endif
 #if defined(ENABLE_WATCHDOG_SLOW)
   // Reset and immediately re-prime the RTC-based watchdog.
   OTV0P2BASE::resetRTCWatchDog();
@@ -1202,6 +3055,23 @@ void loopOpenTRV()
   // ===============
 
 
+#ifdef ENABLE_RADIO_SECONDARY_MODULE
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  loRaAirtimeTick();
+#endif
+  // Poll the secondary radio (eg relay uplink) at the start of each minor cycle,
+  // after boiler control has been updated at the end of the previous cycle.
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+  // Hand over any relay batch that is due so that the poll can start sending it.
+  // Frames queued while the uplink is down are drained a batch at a time once it is back.
+  // Done every cycle, even if the poll is skipped because the cycle started late,
+  // so that batch latency deadlines are counted in real minor cycles.
+  relayFlushIfDue();
+#endif
+  pollSecondaryRadio();
+#endif
+
+
 //  // Warn if too near overrun before.
 //  if(tooNearOverrun) { OTV0P2BASE::serialPrintlnAndFlush(F("?near overrun")); }
 
@@ -1282,20 +3152,35 @@ void loopOpenTRV()
 
   // Once-per-minute tasks: all must take << 0.3s unless particular care is taken.
   // Run tasks spread throughout the minute to be as kind to batteries (etc) as possible.
-  // Only when runAll is true run less-critical tasks that be skipped sometimes when particularly conserving energy.
-  // Run all for first full 4-minute cycle, eg because unit may start anywhere in it.
+  // Only when runAll is true (see above) run less-critical tasks that be skipped sometimes when particularly conserving energy.
   // Note: ensure only take ambient light reading at times when all LEDs are off (or turn them off).
   // TODO: coordinate temperature reading with time when radio and other heat-generating items are off for more accurate readings.
-  const bool runAll = (!conserveBattery) || minute0From4ForSensors || (minuteCount < 4);
 
+#if defined(ENABLE_TASK_BUDGETS)
+  const uint8_t taskSStart = OTV0P2BASE::getSecondsLT();
+  const uint8_t taskSctStart = OTV0P2BASE::getSubCycleTime();
+#endif
   switch(TIME_LSD) // With V0P2BASE_TWO_S_TICK_RTC_SUPPORT only even seconds are available.
     {
     case 0:
       {
       // Tasks that must be run every minute.
       ++minuteCount; // Note simple roll-over to 0 at max value.
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+      // Age any hub slot allocation, and move the search window on after each attempt.
+      if(0 != txSlotValidM) { --txSlotValidM; }
+      else if(1 == (minuteCount & 7)) { txSlotSearchSecond = (txSlotSearchSecond + 2) % TIME_CYCLE_S; }
+#endif
       // Force to user's programmed schedule(s), if any, at the correct time.
       Scheduler.applyUserSchedule(&valveMode, OTV0P2BASE::getMinutesSinceMidnightLT());
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+      // Apply weekly schedule slot edges.
+      weeklyScheduleApply();
+#endif
+#if defined(ENABLE_PREDICTIVE_PREHEAT)
+      // Learn warm-up rate and start scheduled WARM early if needed to reach target on time.
+      predictivePreheat();
+#endif
       // Ensure that the RTC has been persisted promptly when necessary.
       OTV0P2BASE::persistRTC();
       // Run hourly tasks at the end of the hour.
@@ -1309,15 +3194,54 @@ void loopOpenTRV()
       }
 
     // Churn/reseed PRNG(s) a little to improve unpredictability in use: should be lightweight.
-    case 2: { if(runAll) { OTV0P2BASE::seedRNG8(minuteCount ^ OTV0P2BASE::getCPUCycleCount() ^ (uint8_t)Supply_cV.get(), OTV0P2BASE::_getSubCycleTime() ^ AmbLight.get(), (uint8_t)TemperatureC16.get()); } break; }
+    case 2:
+      {
+      if(runAll) { OTV0P2BASE::seedRNG8(minuteCount ^ OTV0P2BASE::getCPUCycleCount() ^ (uint8_t)Supply_cV.get(), OTV0P2BASE::_getSubCycleTime() ^ AmbLight.get(), (uint8_t)TemperatureC16.get()); }
+      break;
+      }
     // Force read of supply/battery voltage; measure and recompute status (etc) less often when already thought to be low, eg when conserving.
-    case 4: { if(runAll) { Supply_cV.read(); } break; }
+    case 4:
+      {
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+      // Count down every minute, but when conserving always read at the usual cadence (only runAll minutes),
+      // and read early after the valve moves.
+      if(runAll && (adaptiveSampleDue(supplySampler) || conserveBattery || adaptiveValveMoving()))
+#else
+      if(runAll)
+#endif
+        {
+        Supply_cV.read();
+#if defined(ENABLE_ENERGY_LEDGER)
+        ++energySensorReads;
+#endif
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+        adaptiveSampleUpdate(supplySampler, Supply_cV.get(), ADAPTIVE_SUPPLY_THRESHOLD_CV, ADAPTIVE_SUPPLY_MAX_M);
+#endif
+        }
+      break;
+      }
 
 #if defined(ENABLE_STATS_TX)
     // Periodic transmission of stats if NOT driving a local valve (else stats can be piggybacked onto that).
     // Randomised somewhat between slots and also within the slot to help avoid collisions.
     static uint8_t txTick;
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+    case 6:
+      {
+      // Pick one of the 8 slots at random unless a hub-allocated slot is valid,
+      // in which case TX is in the local second overlapping it (see below) and none of these is used.
+      txTick = (0 != txSlotValidM) ? 0xff : (OTV0P2BASE::randRNG8() & 7);
+      // A hub takes the first slot after those allocated to its associated nodes, if free.
+      if(inHubMode())
+        {
+        const uint8_t n = OTV0P2BASE::countNodeAssociations();
+        if(n < TX_SLOT_MAX_SLOTS) { txTick = n; }
+        }
+      break;
+      }
+#else
     case 6: { txTick = OTV0P2BASE::randRNG8() & 7; break; } // Pick which of the 8 slots to use.
+#endif // defined(ENABLE_TX_SLOT_ALLOCATION)
     case 8: case 10: case 12: case 14: case 16: case 18: case 20: case 22:
       {
       // Only the slot where txTick is zero is used.
@@ -1329,60 +3253,22 @@ void loopOpenTRV()
       if(useExtraFHT8VTXSlots && localFHT8VTRVEnabled()) { break; }
 #endif
 
-#if !defined(ENABLE_FREQUENT_STATS_TX) // If ENABLE_FREQUENT_STATS_TX then send every minute regardless.
-      // Stats TX in the minute (#1) after all sensors should have been polled
-      // (so that readings are fresh) and evenly between.
-      // Usually send one frame every 4 minutes, 2 if this is a valve.
-      // No extra stats TX for changed data to reduce information/activity leakage.
-      // Note that all O frames contain the current valve percentage,
-      // which implies that any extra stats TX also speeds response to call-for-heat changes.
-#ifdef ENABLE_NOMINAL_RAD_VALVE
-      // DHD20170113: was once every 4 minutes, but can make boiler response too slow.
-      if(0 == (minuteFrom4 & 1)) { break; }
-#else
-      if(!minute1From4AfterSensors) { break; }
-#endif
-#endif
-
-      // Abort if not allowed to send stats at all.
-      // FIXME: fix this to send bare calls for heat / valve % instead from valves for secure non-FHT8V comms.
-      if(!enableTrailingStatsPayload()) { break; }
-
       // Sleep randomly up to ~25% of the minor cycle
       // to spread transmissions and thus help avoid collisions.
       // (Longer than 25%/0.5s could interfere with other ops such as FHT8V TXes.)
-      const uint8_t stopBy = 1 + (((OTV0P2BASE::GSCT_MAX >> 2) | 7) & OTV0P2BASE::randRNG8());
-      while(OTV0P2BASE::getSubCycleTime() <= stopBy)
-        {
-        // Handle any pending I/O while waiting.
-        if(handleQueuedMessages(&Serial, true, &PrimaryRadio)) { continue; }
-        // Sleep a little.
-        OTV0P2BASE::nap(WDTO_15MS, true);
-        }
-
-      // Send stats!
-      // Try for double TX for extra robustness unless:
-      //   * this is a speculative 'extra' TX
-      //   * battery is low
-      //   * this node is a hub so needs to listen as much as possible
-      // This doesn't generally/always need to send binary/both formats
-      // if this is controlling a local FHT8V on which the binary stats can be piggybacked.
-      // Ie, if doesn't have a local TRV then it must send binary some of the time.
-      // Any recently-changed stats value is a hint that a strong transmission might be a good idea.
-#if defined(ENABLE_BINARY_STATS_TX) && defined(ENABLE_FS20_ENCODING_SUPPORT)
-      const bool doBinary = !localFHT8VTRVEnabled() && OTV0P2BASE::randRNG8NextBoolean();
-#else
-      const bool doBinary = false;
-#endif
-      bareStatsTX(!batteryLow && !inHubMode() && ss1.changedValue(), doBinary);
+      statsTXInSlot(1 + (((OTV0P2BASE::GSCT_MAX >> 2) | 7) & OTV0P2BASE::randRNG8()), minuteFrom4, batteryLow);
       break;
       }
 #endif // defined(ENABLE_STATS_TX)
 
-#if defined(ENABLE_SECURE_RADIO_BEACON)
+#if defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_TX_SLOT_ALLOCATION)
     // Send a small secure radio beacon "I'm alive!" message regularly if configured.
+    // A hub allocating TX slots sends one in any case to carry the allocations.
     case 30:
       {
+#if !defined(ENABLE_SECURE_RADIO_BEACON)
+      if(!inHubMode() || (0 == OTV0P2BASE::countNodeAssociations())) { break; }
+#endif
 #if 1 && defined(DEBUG)
       DEBUG_SERIAL_PRINT_FLASHSTRING("Beacon TX... ");
 #endif
@@ -1397,12 +3283,26 @@ void loopOpenTRV()
         }
       const OTRadioLink::SimpleSecureFrame32or0BodyTXBase::fixed32BTextSize12BNonce16BTagSimpleEnc_ptr_t e = OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS;
       const uint8_t txIDLen = OTRadioLink::ENC_BODY_DEFAULT_ID_BYTES;
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+      // A hub allocates stats TX slots to its associated nodes in the beacon body.
+      uint8_t buf[OTRadioLink::generateSecureBeaconMaxBufSize + OTRadioLink::ENC_BODY_SMALL_FIXED_PTEXT_MAX_SIZE];
+      uint8_t slotBody[TX_SLOT_MAX_SLOTS * TX_SLOT_ID_PREFIX_BYTES];
+      static_assert(sizeof(slotBody) < OTRadioLink::ENC_BODY_SMALL_FIXED_PTEXT_MAX_SIZE, "beacon slot body too big");
+      const uint8_t slotBodyLen = inHubMode() ? txSlotAllocationBody(slotBody) : 0;
+      const uint8_t bodylen = (0 == slotBodyLen) ?
+          OTRadioLink::generateSecureBeaconRawForTX(buf, sizeof(buf), txIDLen, e, NULL, key) :
+          OTRadioLink::generateSecureOStyleFrameForTX(buf, sizeof(buf), OTRadioLink::FTS_ALIVE, txIDLen, slotBody, slotBodyLen, e, NULL, key);
+#else
       uint8_t buf[OTRadioLink::generateSecureBeaconMaxBufSize];
       const uint8_t bodylen = OTRadioLink::generateSecureBeaconRawForTX(buf, sizeof(buf), txIDLen, e, NULL, key);
+#endif // defined(ENABLE_TX_SLOT_ALLOCATION)
       // ASSUME FRAMED CHANNEL 0 (but could check with config isUnframed flag).
       // When sending on a channel with framing, do not explicitly send the frame length byte.
       // DO NOT attempt to send if construction of the secure frame failed;
       // doing so may reuse IVs and destroy the cipher security.
+#if defined(ENABLE_ENERGY_LEDGER)
+      if(0 != bodylen) { energyLedgerTX(bodylen-1); }
+#endif
       const bool success = (0 != bodylen) && PrimaryRadio.sendRaw(buf+1, bodylen-1);
 #if 1 && defined(DEBUG)
       DEBUG_SERIAL_PRINT(success);
@@ -1410,7 +3310,7 @@ void loopOpenTRV()
 #endif
       break;
       }
-#endif // defined(ENABLE_SECURE_RADIO_BEACON)
+#endif // defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_TX_SLOT_ALLOCATION)
 
 // SENSOR READ AND STATS
 //
@@ -1428,13 +3328,37 @@ void loopOpenTRV()
 #ifdef TEMP_POT_AVAILABLE
     // Sample the user-selected WARM temperature target at a fixed rate.
     // This allows the unit to stay reasonably responsive to adjusting the temperature dial.
-    case 48: { TempPot.read(); break; }
+    case 48:
+      {
+      TempPot.read();
+#if defined(ENABLE_ENERGY_LEDGER)
+      ++energySensorReads;
+#endif
+      break;
+      }
 #endif
 
     // Read all environmental inputs, late in the cycle.
 #ifdef HUMIDITY_SENSOR_SUPPORT
     // Sample humidity.
-    case 50: { if(runAll) { RelHumidity.read(); } break; }
+    case 50:
+      {
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+      if(runAll && adaptiveSampleDue(rhSampler))
+#else
+      if(runAll)
+#endif
+        {
+        RelHumidity.read();
+#if defined(ENABLE_ENERGY_LEDGER)
+        ++energySensorReads;
+#endif
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+        adaptiveSampleUpdate(rhSampler, RelHumidity.get(), ADAPTIVE_RH_THRESHOLD_PC, ADAPTIVE_RH_MAX_M);
+#endif
+        }
+      break;
+      }
 #endif
 
 #if defined(ENABLE_AMBLIGHT_SENSOR)
@@ -1448,7 +3372,18 @@ void loopOpenTRV()
       // Turn off second UI LED if available.
       OTV0P2BASE::LED_UI2_OFF();
 #endif
-      AmbLight.read();
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+      if(adaptiveSampleDue(lightSampler))
+#endif
+        {
+        AmbLight.read();
+#if defined(ENABLE_ENERGY_LEDGER)
+        ++energySensorReads;
+#endif
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+        adaptiveSampleUpdate(lightSampler, AmbLight.get(), ADAPTIVE_LIGHT_THRESHOLD, ADAPTIVE_LIGHT_MAX_M);
+#endif
+        }
       break;
       }
 #endif
@@ -1457,7 +3392,51 @@ void loopOpenTRV()
     // Force a regular read to make stats such as rate-of-change simple and to minimise lag.
     // TODO: optimise to reduce power consumption when not calling for heat.
     // TODO: optimise to reduce self-heating jitter when in hub/listen/RX mode.
-    case 54: { TemperatureC16.read(); break; }
+    case 54:
+      {
+      bool tempFresh = false;
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+      // Always read while calling for heat so that warm-up is tracked closely,
+      // and while the valve is moving so that the valve model does not run on a stale value.
+      if(NominalRadValve.isCallingForHeat() || adaptiveValveMoving() || adaptiveSampleDue(tempSampler))
+#endif
+        {
+        TemperatureC16.read();
+        tempFresh = true;
+#if defined(ENABLE_ENERGY_LEDGER)
+        ++energySensorReads;
+#endif
+#if defined(ENABLE_ENTROPY_POOL)
+        // The lowest bits of the temperature reading are noisy.
+        entropyPoolAdd(ENTROPY_SRC_SENSOR, (uint8_t)TemperatureC16.get(), 1);
+#endif
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+        adaptiveSampleUpdate(tempSampler, TemperatureC16.get(), ADAPTIVE_TEMP_THRESHOLD_C16, ADAPTIVE_TEMP_MAX_M);
+#endif
+        }
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+      adaptiveLastValvePC = NominalRadValve.get();
+#endif
+#if defined(ENABLE_DS18B20_BUS) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+      ds18b20Bus.collect();
+#endif
+#if defined(ENABLE_MODELLED_RAD_VALVE)
+      // Feed the trend only fresh readings, spread over the minutes since the last one.
+      if(tempTrendM < 0xff) { ++tempTrendM; }
+      if(tempFresh && !TemperatureC16.isErrorValue(TemperatureC16.get()))
+        {
+        tempTrendC16.update(TemperatureC16.get(), tempTrendM);
+        tempTrendM = 0;
+        }
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+      windowOpenTick();
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
+#if defined(ENABLE_MOULD_RISK_MODE)
+      mouldRiskMinute(tempFresh);
+#endif // defined(ENABLE_MOULD_RISK_MODE)
+#endif // defined(ENABLE_MODELLED_RAD_VALVE)
+      break;
+      }
 
     // Compute targets and heat demand based on environmental inputs and occupancy.
     // This should happen as soon after the latest readings as possible (temperature especially).
@@ -1471,6 +3450,10 @@ void loopOpenTRV()
 #if defined(ENABLE_OCCUPANCY_SUPPORT)
       // Update occupancy measures that partially use rolling stats.
 
+#if defined(ENABLE_OCCUPANCY_FUSION)
+      // Age fused evidence, and add any fresh humidity evidence, just ahead of the update.
+      occupancyFusionMinute();
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
       // Update occupancy status (fresh for target recomputation) at a fixed rate.
       Occupancy.read();
 #endif // defined(ENABLE_OCCUPANCY_SUPPORT)
@@ -1492,14 +3475,21 @@ void loopOpenTRV()
         }
 
 #if defined(ENABLE_BOILER_HUB)
-      // Feed in the local valve position when calling for heat just as if over the air.
+      // Feed in the local valve position every minute just as if over the air,
+      // including when closed, so that its hub demand entry never goes stale.
       // (Does not arrive with the normal FHT8V timing of 2-minute gaps so boiler may turn off out of sync.)
-      if(FHT8V.isControlledValveReallyOpen()) { remoteCallForHeatRX(FHT8V.nvGetHC(), FHT8V.get()); }
+      remoteCallForHeatRX(FHT8V.nvGetHC(), FHT8V.get());
 #endif // defined(ENABLE_BOILER_HUB)
 #elif defined(ENABLE_NOMINAL_RAD_VALVE) && defined(ENABLE_LOCAL_TRV) // Other local valve types, simulate a remote call for heat with a fake ID.
 #if defined(ENABLE_BOILER_HUB)
-      // Feed in the local valve position when calling for heat just as if over the air.
-      if(NominalRadValve.isControlledValveReallyOpen()) { remoteCallForHeatRX(~0, NominalRadValve.get()); }
+      // Feed in the local valve position every minute just as if over the air,
+      // including when closed, so that its hub demand entry never goes stale.
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+      // While a window is open the valve is being shut, so report it as closed at once.
+      remoteCallForHeatRX(~0, isWindowOpen() ? 0 : NominalRadValve.get());
+#else
+      remoteCallForHeatRX(~0, NominalRadValve.get());
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
 #endif // defined(ENABLE_BOILER_HUB)
 #endif
 
@@ -1532,6 +3522,47 @@ void loopOpenTRV()
       break;
       }
     }
+#if defined(ENABLE_TASK_BUDGETS)
+  taskBudgetCheck(TIME_LSD / 2, taskSStart, taskSctStart);
+#endif
+
+#if defined(ENABLE_STATS_TX) && defined(ENABLE_TX_SLOT_ALLOCATION)
+  // With a hub-allocated slot, TX in whichever local minor cycle overlaps it,
+  // waiting for the hub's matching minor cycle to start,
+  // unless other work has already used up too much of this one.
+  if(txSlotStatsTXDue(TIME_LSD) && (OTV0P2BASE::getSubCycleTime() < (OTV0P2BASE::GSCT_MAX - (OTV0P2BASE::GSCT_MAX >> 2))))
+    {
+#if defined(ENABLE_FHT8VSIMPLE)
+    // Avoid transmit conflict with FS20.
+    if(!(useExtraFHT8VTXSlots && localFHT8VTRVEnabled()))
+#endif
+      { statsTXInSlot(txSlotPhaseSCT, minuteFrom4, batteryLow); }
+    }
+#endif
+
+#if defined(TEMP_SENSOR_ASYNC)
+  // Start the temperature conversion for the read in slot 54 now,
+  // so that it completes while asleep rather than holding the CPU awake then.
+  if(52 == TIME_LSD)
+#if defined(ENABLE_ADAPTIVE_SAMPLING)
+    if(NominalRadValve.isCallingForHeat() || adaptiveValveMoving() || (0 == tempSampler.waitM))
+#endif
+      { TemperatureC16.startConversion(); }
+#endif
+#if defined(ENABLE_DS18B20_BUS) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+  // Likewise start the external probes converting for collection in slot 54.
+  if(52 == TIME_LSD) { ds18b20Bus.startConversion(); }
+#endif
+
+#if defined(ENABLE_STATS_TX) && defined(ENABLE_FAST_BOOT)
+  // Send any deferred wake-up stats, one frame per minor cycle while there is time.
+  if((0 != bootStatsTXPending) && (OTV0P2BASE::getSubCycleTime() < (OTV0P2BASE::GSCT_MAX/2)))
+    {
+    const bool first = (BOOT_STATS_TX_FRAMES == bootStatsTXPending);
+    bareStatsTX(true, first);
+    bootStatsTXPending = (!first && !ss1.changedValue()) ? 0 : (bootStatsTXPending - 1);
+    }
+#endif
 
 #if defined(ENABLE_FHT8VSIMPLE) && defined(V0P2BASE_TWO_S_TICK_RTC_SUPPORT)
   if(useExtraFHT8VTXSlots)
@@ -1563,6 +3594,12 @@ void loopOpenTRV()
   handleQueuedMessages(&Serial, true, &PrimaryRadio); // Deal with any pending I/O.
 
 #if defined(HAS_DORM1_VALVE_DRIVE) && defined(ENABLE_LOCAL_TRV)
+#if defined(ENABLE_VALVE_FITTED_CACHE)
+  // Remember in EEPROM once the valve has reached normal running (ie has been fitted),
+  // and forget again on a valve error so that the fitter must be involved after a fault.
+  if(ValveDirect.isInNormalRunState()) { valveFittedCacheSet(true); }
+  else if(ValveDirect.isInErrorState()) { valveFittedCacheSet(false); }
+#endif // defined(ENABLE_VALVE_FITTED_CACHE)
   // Handle local direct-drive valve, eg DORM1.
   // If waiting for for verification that the valve has been fitted
   // then accept any manual interaction with controls as that signal.
@@ -1579,6 +3616,13 @@ void loopOpenTRV()
       const bool delayRecalibration = batteryLow || AmbLight.isRoomDark();
       if(valveUI.veryRecentUIControlUse() || (minuteCount >= (delayRecalibration ? 240 : 5)))
           { ValveDirect.signalValveFitted(); }
+#if defined(ENABLE_VALVE_FITTED_CACHE)
+      // After a reset other than at power-on (see setupOpenTRV()) with a valve known to have been fitted and working,
+      // skip the wait for the fitter,
+      // but keep the same low-battery and dark-room deferral since recalibration still runs and is noisy.
+      else if(!delayRecalibration && valveFittedCacheGet())
+          { ValveDirect.signalValveFitted(); }
+#endif // defined(ENABLE_VALVE_FITTED_CACHE)
       }
   // Provide regular poll to motor driver.
   // May take significant time to run
@@ -1590,7 +3634,16 @@ void loopOpenTRV()
   // Note that FHT8V sync will take up at least the first 1s of a 2s subcycle.
   if(!showStatus &&
      (OTV0P2BASE::getSubCycleTime() < ((OTV0P2BASE::GSCT_MAX/4)*3)))
-    { ValveDirect.read(); }
+    {
+#if defined(ENABLE_ENERGY_LEDGER)
+    // Time in the driver is dominated by motor running when the valve moves.
+    const uint8_t sctMotorStart = OTV0P2BASE::getSubCycleTime();
+    ValveDirect.read();
+    energyMotorTicks += energyTicksSince(sctMotorStart);
+#else
+    ValveDirect.read();
+#endif
+    }
 #endif
 
   // Command-Line Interface (CLI) polling.
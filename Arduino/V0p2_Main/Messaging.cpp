@@ -116,6 +116,197 @@ OTRadioLink::OTRadioLink &SecondaryRadio = NullRadio;
 
 // RFM22 is apparently SPI mode 0 for Arduino library pov.
 
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+// Relay store-and-forward queue and batching.
+// Frames to relay are held in a bounded RAM store until the secondary radio accepts them,
+// so that they survive (short) uplink outages such as loss of GSM registration.
+// If the store fills, the oldest lowest-priority frames are dropped first.
+// Frames are sent highest priority first, then oldest first.
+// Without ENABLE_RELAY_BATCHING each frame is sent on its own as soon as the secondary radio accepts it.
+// With ENABLE_RELAY_BATCHING frames are sent in batches;
+// the receiving end must be able to unpack them, so this is off by default.
+// A batch datagram is RELAY_BATCH_MARKER followed by one or more entries,
+// each being a length byte followed by that many bytes of the original frame.
+// The marker (FTp2_NONE, never a valid leading frame byte) distinguishes a batch from a bare frame.
+// A batch of one frame is sent as the bare frame, as without batching,
+// so a receiver need only unpack datagrams starting with the marker.
+#ifndef RELAY_BATCH_MTU
+#define RELAY_BATCH_MTU 64 // Largest datagram to send; fits the SIM900 driver TX buffer.
+#endif
+#if defined(ENABLE_RELAY_BATCHING)
+#ifndef RELAY_BATCH_MAX_LATENCY_S
+#define RELAY_BATCH_MAX_LATENCY_S 30 // Maximum time (s) that a normal-priority frame should wait for others to join it.
+#endif
+#endif
+#ifndef RELAY_STORE_BYTES
+#define RELAY_STORE_BYTES 128 // RAM for queued frames, including 2 bytes overhead per frame.
+#endif
+static_assert(RELAY_STORE_BYTES >= RELAY_BATCH_MTU, "relay store must hold at least one full batch");
+static_assert(RELAY_STORE_BYTES <= 255, "relay store too big");
+// Each store entry is a header byte (frame length, with RELAY_STORE_HIGH_PRIORITY set for high priority),
+// then a byte holding the low 8 bits of the minute count when queued, then the frame.
+static constexpr uint8_t RELAY_STORE_HIGH_PRIORITY = 0x80;
+static constexpr uint8_t RELAY_STORE_ENTRY_OVERHEAD = 2;
+static uint8_t relayStore[RELAY_STORE_BYTES];
+// Bytes used in relayStore; 0 when empty.
+static uint8_t relayStoreLen;
+// Count of frames dropped from the store (or refused) for lack of space; wraps.
+static uint8_t relayStoreDrops;
+#if defined(ENABLE_RELAY_BATCHING)
+static constexpr uint8_t RELAY_BATCH_MARKER = OTRadioLink::FTp2_NONE;
+// Minor cycles left before queued frames should be sent even if not enough to fill a batch.
+static uint8_t relayBatchCyclesLeft;
+#endif
+
+// Minute count (low 8 bits) used to age entries; continuous across midnight.
+static uint8_t relayNowM() { return((uint8_t)((OTV0P2BASE::getDaysSince1999LT() * 1440U) + OTV0P2BASE::getMinutesSinceMidnightLT())); }
+
+// Remove the entry at the given offset in the store.
+static void relayStoreRemove(const uint8_t offset)
+  {
+  const uint8_t el = RELAY_STORE_ENTRY_OVERHEAD + (relayStore[offset] & ~RELAY_STORE_HIGH_PRIORITY);
+  memmove(relayStore + offset, relayStore + offset + el, relayStoreLen - offset - el);
+  relayStoreLen -= el;
+  }
+
+// Find the oldest entry with the given priority; returns -1 if none.
+static int16_t relayStoreFind(const bool highPriority)
+  {
+  for(uint8_t o = 0; o < relayStoreLen; o += RELAY_STORE_ENTRY_OVERHEAD + (relayStore[o] & ~RELAY_STORE_HIGH_PRIORITY))
+    { if(highPriority == (0 != (relayStore[o] & RELAY_STORE_HIGH_PRIORITY))) { return(o); } }
+  return(-1);
+  }
+
+// Number of frames in the relay store.
+uint8_t relayStoreDepth()
+  {
+  uint8_t n = 0;
+  for(uint8_t o = 0; o < relayStoreLen; o += RELAY_STORE_ENTRY_OVERHEAD + (relayStore[o] & ~RELAY_STORE_HIGH_PRIORITY)) { ++n; }
+  return(n);
+  }
+
+// Age in minutes of the oldest frame in the relay store; 0 if empty.
+uint8_t relayStoreOldestAgeM()
+  {
+  // Entries are held in arrival order.
+  return((0 == relayStoreLen) ? 0 : (uint8_t)(relayNowM() - relayStore[1]));
+  }
+
+// Count of frames dropped for lack of space; wraps.
+uint8_t relayStoreDropCount() { return(relayStoreDrops); }
+
+// Queue a frame for relay over the secondary radio.
+bool relayQueueToSend(const uint8_t *const buf, const uint8_t buflen, const bool highPriority)
+  {
+  if((NULL == buf) || (0 == buflen)) { return(false); }
+  // Refuse (and count) a frame too long for the store header or ever to be sent.
+  if((buflen >= RELAY_STORE_HIGH_PRIORITY) || (buflen > RELAY_BATCH_MTU)) { ++relayStoreDrops; return(false); }
+  const uint8_t el = RELAY_STORE_ENTRY_OVERHEAD + buflen;
+  // Make room, dropping the oldest normal-priority frames first, then if need be the oldest high-priority ones.
+  while(relayStoreLen + el > sizeof(relayStore))
+    {
+    int16_t victim = relayStoreFind(false);
+    if((victim < 0) && highPriority) { victim = relayStoreFind(true); }
+    ++relayStoreDrops;
+    if(victim < 0) { return(false); } // Drop this (normal priority) frame instead.
+    relayStoreRemove((uint8_t)victim);
+    }
+#if defined(ENABLE_RELAY_BATCHING)
+  if(0 == relayStoreLen) { relayBatchCyclesLeft = RELAY_BATCH_MAX_LATENCY_S / 2; }
+#endif
+  relayStore[relayStoreLen] = buflen | (highPriority ? RELAY_STORE_HIGH_PRIORITY : 0);
+  relayStore[relayStoreLen + 1] = relayNowM();
+  memcpy(relayStore + relayStoreLen + RELAY_STORE_ENTRY_OVERHEAD, buf, buflen);
+  relayStoreLen += el;
+  return(true);
+  }
+
+// Send the next queued relay frame (or batch) when due.
+// Queued frames stay in the store until the secondary radio accepts them,
+// eg draining one per call once the uplink recovers from an outage.
+void relayFlushIfDue()
+  {
+  if(0 == relayStoreLen) { return; }
+#if !defined(ENABLE_RELAY_BATCHING)
+  // Send the oldest highest-priority frame on its own.
+  const int16_t hp = relayStoreFind(true);
+  const uint8_t o = (hp < 0) ? 0 : (uint8_t)hp;
+  const uint8_t fl = relayStore[o] & ~RELAY_STORE_HIGH_PRIORITY;
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  // Defer while sending would bust the LoRa duty-cycle budget.
+  if(!loRaAirtimeAllow(fl, hp >= 0)) { return; }
+#endif
+  if(!SecondaryRadio.queueToSend(relayStore + o + RELAY_STORE_ENTRY_OVERHEAD, fl)) { return; } // Retry on a later call.
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  loRaAirtimeCharge(fl);
+#endif
+  relayStoreRemove(o);
+#else
+  // Wait (up to the latency deadline) until there is enough queued to fill a batch,
+  // but send at once if any high-priority frame (eg a call for heat) is waiting.
+  if((0 != relayBatchCyclesLeft) && (relayStoreLen < RELAY_BATCH_MTU) && (relayStoreFind(true) < 0)) { --relayBatchCyclesLeft; return; }
+  // Build the batch, highest priority then oldest first, noting which entries are included.
+  // A frame too big to share a batch is sent on its own if it is first in line.
+  uint8_t batch[RELAY_BATCH_MTU];
+  batch[0] = RELAY_BATCH_MARKER;
+  uint8_t batchLen = 1;
+  uint8_t frames = 0;
+  uint8_t firstOffset = 0;
+  bool full = false;
+  bool anyHighPriority = false;
+  bool included[RELAY_STORE_BYTES / (RELAY_STORE_ENTRY_OVERHEAD + 1)];
+  memset(included, false, sizeof(included));
+  for(uint8_t pass = 2; !full && (pass-- > 0); )
+    {
+    const bool highPriority = (0 != pass);
+    uint8_t i = 0;
+    for(uint8_t o = 0; !full && (o < relayStoreLen); ++i)
+      {
+      const uint8_t fl = relayStore[o] & ~RELAY_STORE_HIGH_PRIORITY;
+      if(highPriority == (0 != (relayStore[o] & RELAY_STORE_HIGH_PRIORITY)))
+        {
+        if((0 == frames) && (fl > sizeof(batch) - 2)) { full = true; }
+        if(full || (batchLen + 1 + fl <= sizeof(batch)))
+          {
+          if(0 == frames++) { firstOffset = o; }
+          included[i] = true;
+          anyHighPriority |= highPriority;
+          if(!full)
+            {
+            batch[batchLen++] = fl;
+            memcpy(batch + batchLen, relayStore + o + RELAY_STORE_ENTRY_OVERHEAD, fl);
+            batchLen += fl;
+            }
+          }
+        }
+      o += RELAY_STORE_ENTRY_OVERHEAD + fl;
+      }
+    }
+  const uint8_t firstLen = relayStore[firstOffset] & ~RELAY_STORE_HIGH_PRIORITY;
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  // Defer while sending would bust the LoRa duty-cycle budget.
+  if(!loRaAirtimeAllow((1 == frames) ? firstLen : batchLen, anyHighPriority)) { return; }
+#endif
+  const bool ok = (1 == frames) ?
+      SecondaryRadio.queueToSend(relayStore + firstOffset + RELAY_STORE_ENTRY_OVERHEAD, firstLen) : // Bare frame.
+      SecondaryRadio.queueToSend(batch, batchLen);
+  if(!ok) { return; } // Retry on a later call.
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+  loRaAirtimeCharge((1 == frames) ? firstLen : batchLen);
+#endif
+  // Remove the sent entries.
+  uint8_t i = 0;
+  for(uint8_t o = 0; o < relayStoreLen; ++i)
+    {
+    if(included[i]) { relayStoreRemove(o); }
+    else { o += RELAY_STORE_ENTRY_OVERHEAD + (relayStore[o] & ~RELAY_STORE_HIGH_PRIORITY); }
+    }
+  // Restart the latency deadline for anything left.
+  relayBatchCyclesLeft = RELAY_BATCH_MAX_LATENCY_S / 2;
+#endif // !defined(ENABLE_RELAY_BATCHING)
+  }
+#endif // ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+
 #if defined(ENABLE_RFM23B_FS20_RAW_PREAMBLE)
 // Send the underlying stats binary/text 'whitened' message.
 // This must be terminated with an 0xff (which is not sent),
@@ -137,6 +328,9 @@ void RFM22RawStatsTXFFTerminated(uint8_t * const buf, const bool doubleTX, bool
     DEBUG_SERIAL_PRINT(buflen);
     DEBUG_SERIAL_PRINTLN();
 #endif // DEBUG
+#if defined(ENABLE_ENERGY_LEDGER)
+  energyLedgerTX(buflen, doubleTX);
+#endif
   if(!PrimaryRadio.queueToSend(buf, buflen, 0, (doubleTX ? OTRadioLink::OTRadioLink::TXmax : OTRadioLink::OTRadioLink::TXnormal)))
     {
 #if 0 && defined(DEBUG)
@@ -238,6 +432,12 @@ p->print("FS20 msg HC "); p->print(command.hc1); p->print(' '); p->println(comma
   }
 #endif
 
+#if defined(ENABLE_RADIO_RX) && defined(ENABLE_TX_SLOT_ALLOCATION)
+// Local second and sub-cycle time at which processing of the current RXed frame started.
+// Captured before (slow) decryption so that the hub beacon phase can be estimated.
+static uint8_t rxFrameSeconds, rxFrameSCT;
+#endif
+
 #if defined(ENABLE_RADIO_RX) && defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT) // && defined(ENABLE_FAST_FRAMED_CARRIER_SUPPORT)
 // Handle FS20/FHT8V traffic including binary stats.
 // Returns true on successful frame type match, false if no suitable frame was found/decoded and another parser should be tried.
@@ -330,7 +530,7 @@ DEBUG_SERIAL_PRINTLN();
 
   switch(firstByte) // Switch on type.
     {
-#if defined(ENABLE_SECURE_RADIO_BEACON)
+#if defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_TX_SLOT_ALLOCATION)
 #if defined(ENABLE_OTSECUREFRAME_INSECURE_RX_PERMITTED) // Allow insecure.
     // Beacon / Alive frame, non-secure.
     case OTRadioLink::FTS_ALIVE:
@@ -348,6 +548,29 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("Beacon nonsecure");
 #if 0 && defined(DEBUG)
 DEBUG_SERIAL_PRINTLN_FLASHSTRING("Beacon");
 #endif
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+      // A body from the hub lists leading node ID bytes in stats TX slot order.
+      // Look for this node's ID and take the matching slot, if any.
+      if((0 != decryptedBodyOutSize) && !inHubMode())
+        {
+        if(0 != (decryptedBodyOutSize % TX_SLOT_ID_PREFIX_BYTES)) { break; }
+        uint8_t myID[TX_SLOT_ID_PREFIX_BYTES];
+        for(uint8_t i = 0; i < TX_SLOT_ID_PREFIX_BYTES; ++i) { myID[i] = eeprom_read_byte((uint8_t *)V0P2BASE_EE_START_ID + i); }
+        const uint8_t slots = OTV0P2BASE::fnmin(uint8_t(decryptedBodyOutSize / TX_SLOT_ID_PREFIX_BYTES), TX_SLOT_MAX_SLOTS);
+        for(uint8_t slot = 0; slot < slots; ++slot)
+          {
+          if(0 != memcmp(myID, secBodyBuf + (slot * TX_SLOT_ID_PREFIX_BYTES), TX_SLOT_ID_PREFIX_BYTES)) { continue; }
+#if 0 && defined(DEBUG)
+DEBUG_SERIAL_PRINT_FLASHSTRING("TX slot ");
+DEBUG_SERIAL_PRINT(slot);
+DEBUG_SERIAL_PRINTLN();
+#endif
+          txSlotAllocationRX(slot, rxFrameSeconds, rxFrameSCT);
+          break;
+          }
+        return(true);
+        }
+#endif // defined(ENABLE_TX_SLOT_ALLOCATION)
       // Does not expect any body data.
       if(decryptedBodyOutSize != 0)
         {
@@ -360,7 +583,7 @@ DEBUG_SERIAL_PRINTLN();
         }
       return(true);
       }
-#endif // defined(ENABLE_SECURE_RADIO_BEACON)
+#endif // defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_TX_SLOT_ALLOCATION)
 
     case 'O' | 0x80: // Basic OpenTRV secure frame...
       {
@@ -380,7 +603,8 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("!RX O short"); // "O' frame too short.
       // but use only if valid.
       // Ignore explicit call-for-heat flag for now.
       const uint8_t percentOpen = secBodyBuf[0];
-      if(percentOpen <= 100) { remoteCallForHeatRX(0, percentOpen); } // todo call for heat valve id not passed in.
+      // Key per-valve demand by the first two bytes of the sender's ID.
+      if(percentOpen <= 100) { remoteCallForHeatRX((((uint16_t)senderNodeID[0]) << 8) | senderNodeID[1], percentOpen); }
 #endif
       // If the frame contains JSON stats
       // then forward entire secure frame as-is across the secondary radio relay link,
@@ -388,7 +612,9 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("!RX O short"); // "O' frame too short.
       if((0 != (secBodyBuf[1] & 0x10)) && (decryptedBodyOutSize > 3) && ('{' == secBodyBuf[2]))
         {
 #ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
-        SecondaryRadio.queueToSend(msg, msglen); 
+        // Frames from valves significantly open (ie calling for heat) go ahead of routine stats.
+        const uint8_t pc = secBodyBuf[0];
+        relayQueueToSend(msg, msglen, (pc <= 100) && (pc >= OTRadValve::DEFAULT_VALVE_PC_MODERATELY_OPEN));
 #else // Don't write to console/Serial also if relayed.
         // Write out the JSON message, inserting synthetic ID/@ and seq/+.
         Serial.print(F("{\"@\":\""));
@@ -505,7 +731,7 @@ DEBUG_SERIAL_PRINTLN_FLASHSTRING("Stats IDx");
           }
         // FIXME should only relay authenticated (and encrypted) traffic.
         // Relay stats frame over secondary radio.
-        SecondaryRadio.queueToSend(buf, buflen); 
+        relayQueueToSend(buf, buflen, false);
 #else // Don't write to console/Serial also if relayed.
         // Write out the JSON message.
         OTV0P2BASE::outputJSONStats(&Serial, secure, msg, msglen);
@@ -564,6 +790,14 @@ bool handleQueuedMessages(Print *p, bool wakeSerialIfNeeded, OTRadioLink::OTRadi
     if(!neededWaking && wakeSerialIfNeeded && OTV0P2BASE::powerUpSerialIfDisabled<V0P2_UART_BAUD>()) { neededWaking = true; } // FIXME
     // Don't currently regard anything arriving over the air as 'secure'.
     // FIXME: shouldn't have to cast away volatile to process the message content.
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+    rxFrameSeconds = OTV0P2BASE::getSecondsLT();
+    rxFrameSCT = sctStart;
+#endif
+#if defined(ENABLE_ENTROPY_POOL)
+    // Frame arrival time against the local CPU clock.
+    entropyPoolAdd(ENTROPY_SRC_RX, OTV0P2BASE::getCPUCycleCount() ^ sctStart, 1);
+#endif
     decodeAndHandleRawRXedMessage(p, false, (const uint8_t *)pb);
     rl->removeRXMsg();
     // Note that some work has been done.
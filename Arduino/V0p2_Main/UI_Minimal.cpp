@@ -57,13 +57,77 @@ valveUI_t valveUI(
 //   +EXT .....
 // where EXT is the name of the extension, usually 3 letters.
 
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+// Parse exactly len bytes of hex (2 chars each) from s into out; false if malformed or wrong length.
+static bool parseHexBytes(const char *s, uint8_t *const out, const uint8_t len)
+  {
+  if(strlen(s) != 2U * len) { return(false); }
+  for(uint8_t i = 0; i < 2*len; ++i)
+    {
+    const char c = s[i];
+    const uint8_t v = ((c >= '0') && (c <= '9')) ? (c - '0') :
+                      ((c >= 'A') && (c <= 'F')) ? (c - 'A' + 10) :
+                      ((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) : 0xff;
+    if(0xff == v) { return(false); }
+    if(0 == (i & 1)) { out[i/2] = v << 4; } else { out[i/2] |= v; }
+    }
+  return(true);
+  }
+// True if s is exactly one digit 0 to 6, a day of the week; atoi() would also take "1x" or "-0".
+static bool isDayToken(const char *const s) { return(('0' <= s[0]) && (s[0] <= '6') && ('\0' == s[1])); }
+// Weekly schedule, one line per command:
+//   +SCH                show each day's slots as 6 hex digits (Monday first) and today's day
+//   +SCH D n            declare today to be day n, Monday being 0
+//   +SCH n hhhhhh       set day n's 24 hourly WARM slots, earliest hour in LSB of first byte
+//   +SCH W hhhh...hh    set all 7 days at once (42 hex digits)
+static bool weeklyScheduleCLI(Print *const p, char *const buf)
+  {
+  char *last; // Used by strtok_r().
+  char *const tok1 = strtok_r(buf + 4, " ", &last);
+  uint8_t bits[WEEKLY_SCHEDULE_BYTES];
+  if(NULL == tok1)
+    {
+    for(uint8_t d = 0; d < 7; ++d)
+      {
+      weeklyScheduleGetDay(d, bits);
+      p->print(d); p->print(' ');
+      for(uint8_t i = 0; i < WEEKLY_SCHEDULE_BYTES_PER_DAY; ++i)
+        { if(bits[i] < 16) { p->print('0'); } p->print(bits[i], HEX); }
+      p->println();
+      }
+    p->print(F("D ")); p->println(weeklyScheduleDayOfWeek());
+    return(true);
+    }
+  char *const tok2 = strtok_r(NULL, " ", &last);
+  if(NULL == tok2) { return(false); }
+  if('D' == tok1[0])
+    {
+    if(!isDayToken(tok2)) { return(false); }
+    weeklyScheduleSetDayOfWeek((uint8_t)(tok2[0] - '0'));
+    return(true);
+    }
+  if('W' == tok1[0])
+    {
+    if(!parseHexBytes(tok2, bits, WEEKLY_SCHEDULE_BYTES)) { return(false); }
+    for(uint8_t d = 0; d < 7; ++d) { weeklyScheduleSetDay(d, bits + (d * WEEKLY_SCHEDULE_BYTES_PER_DAY)); }
+    return(true);
+    }
+  if(!isDayToken(tok1) || !parseHexBytes(tok2, bits, WEEKLY_SCHEDULE_BYTES_PER_DAY)) { return(false); }
+  weeklyScheduleSetDay((uint8_t)(tok1[0] - '0'), bits);
+  return(true);
+  }
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
+
 // It is acceptable for extCLIHandler() to alter the buffer passed,
 // eg with strtok_t().
 static bool extCLIHandler(Print *const p, char *const buf, const uint8_t n)
   {
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+  if((n >= 4) && (0 == strncmp(buf, "+SCH", 4)) && ((4 == n) || (' ' == buf[4]))) { return(weeklyScheduleCLI(p, buf)); }
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
   return(false); // FAILED if not otherwise handled.
   }
-#endif 
+#endif
 
 
 #if defined(ENABLE_CLI_HELP) && !defined(ENABLE_TRIMMED_MEMORY)
@@ -137,6 +201,9 @@ static void dumpCLIUsage(const uint8_t stopBy)
   printCLILine(deadline, F("L S"), F("Learn daily warm now, clear if in frost mode, schedule S"));
   //printCLILine(deadline, F("P HH MM"), F("Program: warm daily starting at HH MM schedule 0"));
   printCLILine(deadline, F("P HH MM S"), F("Program: warm daily starting at HH MM schedule S"));
+#endif
+#if defined(ENABLE_WEEKLY_SCHEDULE) && defined(ENABLE_EXTENDED_CLI)
+  printCLILine(deadline, F("+SCH ..."), F("weekly schedule: show, D n, n hhhhhh, W hex*42"));
 #endif
   printCLILine(deadline, F("O PP"), F("min % for valve to be Open"));
 #if defined(ENABLE_NOMINAL_RAD_VALVE)
@@ -217,7 +284,20 @@ void pollCLI(const uint8_t maxSCT, const bool startOfMinute, const OTV0P2BASE::S
 #endif
 
       // Reset or display ID.
+#if defined(ENABLE_ENTROPY_POOL)
+      // "I *" takes the new ID from the sketch entropy pool when it holds enough,
+      // then just displays it; otherwise the library resets it the slow way.
+      case 'I':
+        {
+        const bool fromPool = (3 == n) && ('*' == buf[2]) && entropyPoolResetID();
 #ifdef ENABLE_ID_SET_FROM_CLI
+        showStatus = OTV0P2BASE::CLI::NodeIDWithSet().doCommand(buf, fromPool ? 1 : n);
+#else
+        showStatus = OTV0P2BASE::CLI::NodeID().doCommand(buf, fromPool ? 1 : n);
+#endif
+        break;
+        }
+#elif defined(ENABLE_ID_SET_FROM_CLI)
       case 'I': { showStatus = OTV0P2BASE::CLI::NodeIDWithSet().doCommand(buf, n); break; }
 #else
       case 'I': { showStatus = OTV0P2BASE::CLI::NodeID().doCommand(buf, n); break; }
@@ -346,7 +426,12 @@ void pollCLI(const uint8_t maxSCT, const bool startOfMinute, const OTV0P2BASE::S
           }
         else
 #endif
-          { valveMode.setWarmModeDebounced(false); } // No parameter supplied; switch to FROST mode.
+          {
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+          windowOpenCancel(); // Explicit user choice of FROST is not to be undone on window close.
+#endif
+          valveMode.setWarmModeDebounced(false); // No parameter supplied; switch to FROST mode.
+          }
         break;
         }
 #endif // defined(ENABLE_LOCAL_TRV)
@@ -428,7 +513,14 @@ void pollCLI(const uint8_t maxSCT, const bool startOfMinute, const OTV0P2BASE::S
 #if defined(ENABLE_LOCAL_TRV) && !defined(ENABLE_TRIMMED_MEMORY)
       // Switch to (or restart) BAKE (Quick Heat) mode: Q
       // We can live without this if very short of memory.
-      case 'Q': { valveMode.startBake(); break; }
+      case 'Q':
+        {
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+        windowOpenCancel();
+#endif
+        valveMode.startBake();
+        break;
+        }
 #endif
 
 #if !defined(ENABLE_TRIMMED_MEMORY)
@@ -451,6 +543,9 @@ void pollCLI(const uint8_t maxSCT, const bool startOfMinute, const OTV0P2BASE::S
         else
 #endif
           {
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+          windowOpenCancel();
+#endif
           valveMode.cancelBakeDebounced(); // Ensure BAKE mode not entered.
           valveMode.setWarmModeDebounced(true); // No parameter supplied; switch to WARM mode.
           }
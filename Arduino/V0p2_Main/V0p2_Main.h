@@ -66,6 +66,17 @@ Author(s) / Copyright (s): Damon Hart-Davis 2013--2017
 // Fixups to apply after loading the target config.
 #include <OTV0p2_valve_ENABLE_fixups.h>
 
+// Staged boot: do only what is needed for safe control before the first valve computation
+// and leave remaining checks and the wake-up stats burst to the main loop.
+// ENABLE_MIN_ENERGY_BOOT is the most frugal profile of this, also skipping some boot work entirely.
+#if defined(ENABLE_MIN_ENERGY_BOOT) && !defined(ENABLE_FAST_BOOT)
+#define ENABLE_FAST_BOOT
+#endif
+// Measure time from the boot xtal check to first control action (reported as bT); can be enabled alone for comparison.
+#if defined(ENABLE_FAST_BOOT) && !defined(ENABLE_BOOT_TIME_STAT)
+#define ENABLE_BOOT_TIME_STAT
+#endif
+
 #include <OTV0p2_Board_IO_Config.h> // I/O pin allocation and setup: include ahead of I/O module headers.
 
 #include <Arduino.h>
@@ -75,7 +86,7 @@ Author(s) / Copyright (s): Damon Hart-Davis 2013--2017
 #include <OTRFM23BLink.h>
 #include <OTSIM900Link.h>
 #include <OTRN2483Link.h>
-#if defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT) || defined(ENABLE_SECURE_RADIO_BEACON)
+#if defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT) || defined(ENABLE_SECURE_RADIO_BEACON) || defined(ENABLE_ENTROPY_POOL)
 #include <OTAESGCM.h>
 #endif
 
@@ -117,6 +128,39 @@ extern OTRadioLink::OTRadioLink &SecondaryRadio;
 extern const OTSIM900Link::OTSIM900LinkConfig_t SIM900Config;
 #endif // ENABLE_RADIO_SIM900
 
+#if defined(ENABLE_RADIO_SECONDARY_RN2483)
+// LoRa airtime budgeting for the RN2483 secondary radio.
+// Estimates time on air for each frame and keeps within the regulatory duty cycle (1% in EU868).
+// Returns true if a frame with the given payload size may be sent now.
+// Normal-priority frames are refused once the budget falls into a reserve kept for high-priority ones.
+bool loRaAirtimeAllow(uint8_t payloadBytes, bool highPriority);
+// Charge the budget for a frame with the given payload size; call only once it has been accepted to send.
+void loRaAirtimeCharge(uint8_t payloadBytes);
+#endif // defined(ENABLE_RADIO_SECONDARY_RN2483)
+
+#ifdef ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+// Queue a frame for relay over the secondary radio.
+// Frames are held in a bounded store-and-forward queue until the secondary radio accepts them,
+// eg across GSM registration loss or LoRa duty-cycle limits,
+// High-priority frames (eg calls for heat, boiler state) are sent first and dropped last if the queue fills.
+// IF DEFINED: ENABLE_RELAY_BATCHING sends frames batched to amortise the per-send overhead
+// (eg of a GSM UDP send or LoRa TX), in a format that the receiver must unpack;
+// a batch is sent when full, when a high-priority frame is waiting,
+// else when its oldest frame has waited about RELAY_BATCH_MAX_LATENCY_S.
+// The frame is copied and the buffer can be reused immediately.
+// Returns false if the frame could not be accepted.
+bool relayQueueToSend(const uint8_t *buf, uint8_t buflen, bool highPriority);
+// Send the next queued relay frame (or batch) if due.
+// Should be called once per minor cycle.
+void relayFlushIfDue();
+// Number of frames waiting in the relay queue.
+uint8_t relayStoreDepth();
+// Age in minutes of the oldest frame in the relay queue; 0 if empty.
+uint8_t relayStoreOldestAgeM();
+// Count of frames dropped from the relay queue for lack of space; wraps.
+uint8_t relayStoreDropCount();
+#endif // ENABLE_RADIO_SECONDARY_MODULE_AS_RELAY
+
 static constexpr uint8_t RFM22_PREAMBLE_BYTE = 0xaa; // Preamble byte for RFM22/23 reception.
 static constexpr uint8_t RFM22_PREAMBLE_MIN_BYTES = 4; // Minimum number of preamble bytes for reception.
 static constexpr uint8_t RFM22_PREAMBLE_BYTES = 5; // Recommended number of preamble bytes for reliable reception.
@@ -247,15 +291,148 @@ extern AmbientLight AmbLight;
 extern OTV0P2BASE::MinimalOneWire<> MinOW_DEFAULT_OWDQ;
 #endif
 
+#if defined(ENABLE_DS18B20_BUS)
+#if !defined(ENABLE_MINIMAL_ONEWIRE_SUPPORT)
+#error ENABLE_DS18B20_BUS needs ENABLE_MINIMAL_ONEWIRE_SUPPORT
+#endif
+#ifndef DS18B20_BUS_MAX_PROBES
+#define DS18B20_BUS_MAX_PROBES 4
+#endif
+// Conversions (nominally minutes) between searches for probes while none have been found.
+#ifndef DS18B20_BUS_SEARCH_RETRY_M
+#define DS18B20_BUS_SEARCH_RETRY_M 60
+#endif
+// All the DS18B20 probes on the default OneWire bus, eg for DHW or multi-zone installs.
+// ROMs are found by one search and cached on first use;
+// if none are found the search is retried every DS18B20_BUS_SEARCH_RETRY_M conversion attempts.
+// A single Skip ROM 'convert T' starts every probe converting at once,
+// and each is then read in turn by its cached ROM with its scratchpad CRC checked,
+// so conversion wall time does not grow with the number of probes.
+// Probe 0 is the first found by the usual deterministic search.
+class DS18B20Bus final
+  {
+  private:
+    OTV0P2BASE::MinimalOneWireBase &ow;
+    // Precision in bits [9,12].
+    const uint8_t precision;
+    bool initialised;
+    // True if a conversion has been started and not yet collected.
+    bool converting;
+    // Conversion attempts left until the next search while no probes have been found.
+    uint8_t searchWaitM;
+    uint8_t probes;
+    uint8_t rom[DS18B20_BUS_MAX_PROBES][8];
+    int16_t values[DS18B20_BUS_MAX_PROBES];
+    // Find and cache probe ROMs and set their precision; false if none found.
+    bool init();
+  public:
+    DS18B20Bus(OTV0P2BASE::MinimalOneWireBase &_ow, const uint8_t _precision)
+      : ow(_ow), precision(_precision), initialised(false), converting(false), searchWaitM(0), probes(0) { }
+    // Number of probes found; 0 before first use.
+    uint8_t getProbeCount() const { return(probes); }
+    uint8_t getPrecisionBits() const { return(precision); }
+    // Start all probes converting; returns false if none or on error.
+    bool startConversion();
+    // Read all probes' results, first starting a conversion and waiting for it if none is pending.
+    // Returns false if any probe could not be read.
+    bool collect();
+    // Last value (C16) from the given probe, or DEFAULT_INVALID_TEMP if none.
+    int16_t get(const uint8_t i) const
+      { return((i < probes) ? values[i] : OTV0P2BASE::TemperatureC16Base::DEFAULT_INVALID_TEMP); }
+  };
+extern DS18B20Bus ds18b20Bus;
+#endif // defined(ENABLE_DS18B20_BUS)
+
 // Cannot have internal and external use of same DS18B20 at same time...
-#if defined(ENABLE_EXTERNAL_TEMP_SENSOR_DS18B20) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20) && defined(ENABLE_MINIMAL_ONEWIRE_SUPPORT)
+#if defined(ENABLE_DS18B20_BUS)
+// External probes are all handled by ds18b20Bus.
+#elif defined(ENABLE_EXTERNAL_TEMP_SENSOR_DS18B20) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20) && defined(ENABLE_MINIMAL_ONEWIRE_SUPPORT)
 #define SENSOR_EXTERNAL_DS18B20_ENABLE_0 // Enable sensor zero.
 extern OTV0P2BASE::TemperatureC16_DS18B20 extDS18B20_0;
 #endif
 
 // Ambient/room temperature sensor, usually on main board.
+#if defined(ENABLE_SIMULATED_ROOM)
+#if !defined(ENABLE_LOCAL_TRV)
+#error ENABLE_SIMULATED_ROOM needs ENABLE_LOCAL_TRV
+#endif
+// Bench/closed-loop test stand-in for the room temperature sensor.
+// Each read() steps a lumped room/radiator/boiler thermal model by one minute,
+// driven by the local valve position, and returns the room temperature
+// quantised to 1/16C with a little random jitter as from a real sensor.
+// Lets the real controller run closed-loop on a board with no radiator attached.
+class SimulatedRoomTemperatureC16 final : public OTV0P2BASE::TemperatureC16Base
+  {
+  private:
+    // Room and radiator temperatures in 1/4096C for fine resolution in the model.
+    int32_t roomC4096;
+    int32_t radC4096;
+  public:
+    SimulatedRoomTemperatureC16();
+    // Advance the model by one minute and return the new (noisy, quantised) room temperature.
+    virtual int16_t read();
+  };
+extern SimulatedRoomTemperatureC16 TemperatureC16;
+#elif defined(ENABLE_ASYNC_I2C_SENSORS) && !defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+#define TEMP_SENSOR_ASYNC // TemperatureC16 has startConversion().
+#define TEMP_SENSOR_I2C_ASYNC
+// Split-phase I2C room temperature sensor.
+// startConversion() sets the device converting and releases the bus at once,
+// so the conversion runs while the CPU sleeps or does other work;
+// a later read() collects the result, or if nothing was started
+// starts a conversion and waits for it just as a blocking driver would.
+class AsyncRoomTemperatureC16Base : public OTV0P2BASE::TemperatureC16Base
+  {
+  private:
+    // True if a conversion has been started and not yet collected.
+    bool started;
+  protected:
+    // Send the command to start a conversion, with TWI powered; false on error.
+    virtual bool startI2C() = 0;
+    // Collect a completed conversion into value, with TWI powered; false if not complete or on error.
+    virtual bool fetchI2C() = 0;
+  public:
+    AsyncRoomTemperatureC16Base() : started(false) { }
+    // Start a conversion for a later read(); returns false on error.
+    bool startConversion();
+    virtual int16_t read();
+  };
 #if defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
+// SHT21 temperature using the no-hold-master command, at 12-bit (1/16C) resolution.
+class AsyncRoomTemperatureC16_SHT21 final : public AsyncRoomTemperatureC16Base
+  {
+  private:
+    bool initialised;
+  protected:
+    virtual bool startI2C();
+    virtual bool fetchI2C();
+  public:
+    AsyncRoomTemperatureC16_SHT21() : initialised(false) { }
+  };
+extern AsyncRoomTemperatureC16_SHT21 TemperatureC16;
+#else
+// TMP112 temperature using a one-shot conversion from shutdown mode.
+class AsyncRoomTemperatureC16_TMP112 final : public AsyncRoomTemperatureC16Base
+  {
+  protected:
+    virtual bool startI2C();
+    virtual bool fetchI2C();
+  };
+extern AsyncRoomTemperatureC16_TMP112 TemperatureC16;
+#endif
+#elif defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
 extern OTV0P2BASE::RoomTemperatureC16_SHT21 TemperatureC16; // SHT21 impl.
+#elif defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20) && defined(ENABLE_DS18B20_BUS)
+#define TEMP_SENSOR_ASYNC // TemperatureC16 has startConversion().
+// Room temperature from probe 0 on the DS18B20 bus; any others are reported separately.
+class DS18B20BusTemperatureC16 final : public OTV0P2BASE::TemperatureC16Base
+  {
+  public:
+    bool startConversion() { return(ds18b20Bus.startConversion()); }
+    virtual int16_t read();
+    virtual int8_t getBitsAfterPoint() const { return(ds18b20Bus.getPrecisionBits() - 8); }
+  };
+extern DS18B20BusTemperatureC16 TemperatureC16;
 #elif defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
   #if defined(ENABLE_MINIMAL_ONEWIRE_SUPPORT)
   // DSB18B20 temperature impl, with slightly reduced precision to improve speed.
@@ -295,7 +472,11 @@ void setupOpenTRV();
 void loopOpenTRV();
 
 // Select basic parameter set to use (or could define new set here).
-#ifndef DHW_TEMPERATURES
+// A build config may supply its own pack, eg one tuned offline for a building type,
+// by defining VALVE_CONTROL_PARAMS as an OTRadValve::ValveControlParameters<...> instance type.
+#if defined(VALVE_CONTROL_PARAMS)
+typedef VALVE_CONTROL_PARAMS PARAMS;
+#elif !defined(DHW_TEMPERATURES)
 // Settings for room TRV.
 typedef OTRadValve::DEFAULT_ValveControlParameters PARAMS;
 #else
@@ -390,6 +571,242 @@ extern OTRadValve::ModelledRadValve NominalRadValve;
 #define NominalRadValve FHT8V
 #endif
 
+#if defined(ENABLE_MODELLED_RAD_VALVE)
+// Recent trend of the raw room temperature (C16), one sample per minute, at O(1) cost and without a sample buffer.
+// The valve model already holds the last 16 samples in its own filter memory,
+// so rather than duplicate that, this keeps Brown's double exponential smoothing,
+// which is the discounted least-squares straight-line fit to all past samples,
+// each weighted by 3/4 per minute of age; after a step change in slope
+// it settles about as fast as a plain fit over the last 16 samples would.
+class TemperatureTrendC16 final
+  {
+  private:
+    // Smoothing shift: alpha = 1/4.
+    static constexpr uint8_t alphaShift = 2;
+    // Single and double smoothed values, C16 scaled by 256.
+    int32_t s1, s2;
+    // Previous sample (C16).
+    int16_t last;
+    // True once the first sample has been taken.
+    bool initialised;
+    // Apply one minute's smoothing step towards y (C16 scaled by 256).
+    void step(const int32_t y)
+      {
+      s1 += (y - s1) / (1 << alphaShift);
+      s2 += (s1 - s2) / (1 << alphaShift);
+      }
+
+  public:
+    TemperatureTrendC16() : s1(0), s2(0), last(0), initialised(false) { }
+
+    // Add a new sample taken the given number of minutes [1,255] after the previous one; O(minutes).
+    // Minutes without a fresh sample are filled by linear interpolation
+    // so that the per-minute smoothing and the slope stay in step with real time.
+    // The first sample is taken as a steady history, as for the valve model filter.
+    void update(const int16_t rawTempC16, const uint8_t minutes = 1)
+      {
+      if(!initialised)
+        {
+        s1 = s2 = (int32_t)rawTempC16 << 8;
+        last = rawTempC16;
+        initialised = true;
+        return;
+        }
+      const int32_t delta = ((int32_t)rawTempC16 - last) << 8;
+      for(uint16_t i = 1; i <= minutes; ++i)
+        { step(((int32_t)last << 8) + ((delta * (int32_t)i) / minutes)); }
+      last = rawTempC16;
+      }
+
+    // True once at least one sample has been taken.
+    bool isInitialised() const { return(initialised); }
+
+    // Smoothed temperature (C16), rounded.
+    int16_t getSmoothed() const { return((int16_t)((s1 + 128) >> 8)); }
+
+    // Least-squares slope in C16 per hour, negative when falling; O(1).
+    // Per minute the slope is alpha/(1-alpha) * (s1-s2) = (s1-s2)/3.
+    int16_t getSlopeC16PerH() const
+      { return((int16_t)(((s1 - s2) * 60) / (((1 << alphaShift) - 1) * 256L))); }
+  };
+// Singleton trend of the room temperature as seen by the valve model.
+extern TemperatureTrendC16 tempTrendC16;
+#endif // defined(ENABLE_MODELLED_RAD_VALVE)
+
+#if defined(ENABLE_WINDOW_OPEN_DETECTION)
+#if !defined(ENABLE_MODELLED_RAD_VALVE)
+#error ENABLE_WINDOW_OPEN_DETECTION needs ENABLE_MODELLED_RAD_VALVE
+#endif
+// Detect an open window from a steep fall in room temperature, while WARM.
+// Drops to FROST, so closing the valve and cancelling any call for heat,
+// then restores WARM once the temperature stops falling (or after a time limit).
+// Keeps its own short per-minute window of temperatures, as the smoothed trend is too slow to react.
+// Should be called once per minute after any fresh temperature reading.
+void windowOpenTick();
+// Least-squares temperature slope (C16 per hour) over the detector's recent samples.
+int16_t windowOpenSlopeC16PerH();
+// Minutes spent so far in the window-open state; 0 when not in it.
+uint8_t windowOpenMinutes();
+// True while an open window is believed to be causing the room to cool.
+bool isWindowOpen();
+// Leave the window-open state without changing mode, eg when the user explicitly selects a mode.
+void windowOpenCancel();
+#endif // defined(ENABLE_WINDOW_OPEN_DETECTION)
+
+#if defined(ENABLE_PREDICTIVE_PREHEAT)
+#if !defined(ENABLE_SINGLETON_SCHEDULE) || !defined(ENABLE_LOCAL_TRV)
+#error ENABLE_PREDICTIVE_PREHEAT needs ENABLE_SINGLETON_SCHEDULE and ENABLE_LOCAL_TRV
+#endif
+// Number of start-temperature bands for which a warm-up rate is learned.
+static constexpr uint8_t PREHEAT_RATE_BANDS = 4;
+// Learn the room warm-up rate and start scheduled WARM early enough to reach target on time.
+// Should be called once per minute after the user schedule has been applied.
+void predictivePreheat();
+// Learned warm-up rate (C16 per hour) for the current room temperature; 0xff if not yet learned.
+uint8_t getPreheatRateC16PerH();
+#endif // defined(ENABLE_PREDICTIVE_PREHEAT)
+
+#if defined(ENABLE_MOULD_RISK_MODE)
+#if !defined(HUMIDITY_SENSOR_SUPPORT) || !defined(ENABLE_MODELLED_RAD_VALVE)
+#error ENABLE_MOULD_RISK_MODE needs HUMIDITY_SENSOR_SUPPORT and ENABLE_MODELLED_RAD_VALVE
+#endif
+// Dew point (C16) from temperature (C16) and relative humidity (%), by the Magnus formula in fixed point.
+// Within 1/16C of the floating-point formula over -10C to 40C; RH below 20% is treated as 20%.
+int16_t dewPointC16(int16_t tempC16, uint8_t rhPC);
+#if defined(DEBUG)
+// Check dewPointC16() against test vectors from the floating-point formula; true if all are within 1/16C.
+bool dewPointC16SelfTest();
+#endif
+// True while the room's dew point is close enough to its temperature
+// that cooler surfaces (walls, window reveals) are at risk of mould;
+// setbacks are then suppressed to keep surfaces warmer.
+bool isMouldRisk();
+// Count a minute at the current risk, first recomputing it if fresh is true,
+// ie if the temperature was read this minute; call once per minute.
+void mouldRiskMinute(bool fresh);
+// Hours of the last 24 with mould risk for at least half the hour.
+uint8_t mouldRiskHours();
+#endif // defined(ENABLE_MOULD_RISK_MODE)
+
+#if defined(ENABLE_OCCUPANCY_FUSION)
+#if !defined(ENABLE_OCCUPANCY_SUPPORT)
+#error ENABLE_OCCUPANCY_FUSION needs ENABLE_OCCUPANCY_SUPPORT
+#endif
+// Fused occupancy evidence from several sources.
+// Each event adds its source's weight to a score that decays by about 1/16 each minute,
+// and the score plus a prior from this hour's smoothed occupancy stats
+// decides whether to mark the room as possibly or just-possibly occupied.
+// Constant memory and O(1) per event.
+static constexpr uint8_t OCC_FUSION_WEIGHT_LIGHT_STRONG = 128; // Lights switched on.
+static constexpr uint8_t OCC_FUSION_WEIGHT_LIGHT_WEAK = 40; // Smaller light change, eg curtains.
+static constexpr uint8_t OCC_FUSION_WEIGHT_VOICE = 128;
+static constexpr uint8_t OCC_FUSION_WEIGHT_UI = 200; // Someone physically adjusted the valve.
+static constexpr uint8_t OCC_FUSION_WEIGHT_RH_RISE = 48; // Sharp humidity rise, eg cooking or shower.
+// Add evidence of occupancy with the given weight.
+void occupancyFusionEvent(uint8_t weight);
+// Decay the score and look for humidity evidence; call once per minute.
+void occupancyFusionMinute();
+// Refresh the hourly prior from the occupancy stats; call when stats are updated.
+void occupancyFusionUpdatePrior();
+// Current confidence [0,100] that the room is occupied.
+uint8_t occupancyFusionConfidencePC();
+#endif // defined(ENABLE_OCCUPANCY_FUSION)
+
+#if defined(ENABLE_WEEKLY_SCHEDULE)
+#if !defined(ENABLE_LOCAL_TRV)
+#error ENABLE_WEEKLY_SCHEDULE needs ENABLE_LOCAL_TRV
+#endif
+#if !defined(ENABLE_EXTENDED_CLI)
+#error ENABLE_WEEKLY_SCHEDULE needs ENABLE_EXTENDED_CLI for the +SCH command
+#endif
+// Weekly schedule: one bit per hour of each day of the week saying whether that hour should be WARM.
+// Held in EEPROM as 3 bytes per day, Monday first, earliest hour in the least significant bit of each byte.
+// Runs alongside any simple schedule, switching WARM on at the start and off at the end of each WARM run,
+// so that manual changes in between are respected until the next edge.
+static constexpr uint8_t WEEKLY_SCHEDULE_BYTES_PER_DAY = 3;
+static constexpr uint8_t WEEKLY_SCHEDULE_BYTES = 7 * WEEKLY_SCHEDULE_BYTES_PER_DAY;
+// Day of the week now, Monday being 0, from the RTC date and the stored adjustment.
+uint8_t weeklyScheduleDayOfWeek();
+// True if the given hour [0,23] of the given day [0,6] is a WARM slot.
+bool weeklyScheduleIsWarm(uint8_t dow, uint8_t hour);
+// Minutes until the next WARM slot starts: 0 if in one now, ~0 if there are none.
+// O(1) except for a look-ahead through the week once per hour or after a change.
+uint16_t weeklyScheduleMinutesToWarm();
+// Get or set the 3 bytes of slots for one day [0,6]; the setter only writes EEPROM bytes that change.
+void weeklyScheduleGetDay(uint8_t dow, uint8_t bits[WEEKLY_SCHEDULE_BYTES_PER_DAY]);
+void weeklyScheduleSetDay(uint8_t dow, const uint8_t bits[WEEKLY_SCHEDULE_BYTES_PER_DAY]);
+// Declare today to be the given day of the week [0,6], Monday being 0.
+void weeklyScheduleSetDayOfWeek(uint8_t dow);
+// Switch WARM mode on or off at slot edges; call once per minute.
+void weeklyScheduleApply();
+#endif // defined(ENABLE_WEEKLY_SCHEDULE)
+
+#if defined(ENABLE_ENERGY_LEDGER)
+// Lightweight energy accounting: counts CPU awake time, primary radio TX bytes and RX listen time,
+// motor run time and sensor reads, and turns them into average currents with per-board coefficients.
+// Estimates only, good for comparing configurations rather than for predicting exact battery life.
+// Note bytes about to be sent by the primary radio; doubleTX if the frame is sent twice.
+void energyLedgerTX(uint8_t len, bool doubleTX = false);
+#endif // defined(ENABLE_ENERGY_LEDGER)
+
+// IF DEFINED: while conserving battery with the per-cycle work (UI, valve motor, CLI, etc) idle,
+// sleep through the minor cycles in which no once-per-minute task is due (from the task table in Control.cpp).
+// The 2s RTC tick still wakes the CPU briefly, but the main loop body is not run;
+// any other wake-up (eg button, serial, radio) ends the skip so the next cycle runs in full.
+// UI LED status flashes are only shown in cycles that run.
+#if defined(ENABLE_IDLE_CYCLE_SKIP) && defined(ENABLE_RADIO_SECONDARY_MODULE)
+#error ENABLE_IDLE_CYCLE_SKIP cannot be used with ENABLE_RADIO_SECONDARY_MODULE (polled every minor cycle)
+#endif
+
+#if defined(ENABLE_ADAPTIVE_SAMPLING) && !defined(ENABLE_MODELLED_RAD_VALVE)
+#error ENABLE_ADAPTIVE_SAMPLING needs ENABLE_MODELLED_RAD_VALVE
+#endif
+#if defined(ENABLE_ADAPTIVE_SAMPLING) && defined(ENABLE_SIMULATED_ROOM)
+#error ENABLE_ADAPTIVE_SAMPLING cannot be used with ENABLE_SIMULATED_ROOM (each read steps the model one minute)
+#endif
+
+#if defined(ENABLE_BOOT_TIME_STAT)
+// Time from the xtal check in setup() to the initial valve computation in ms, by the RTC.
+extern uint16_t bootTimeMs;
+#endif // defined(ENABLE_BOOT_TIME_STAT)
+
+#if defined(ENABLE_ENTROPY_POOL)
+// Small entropy pool fed during normal running from wake-up jitter, sensor LSBs and RX timing,
+// so that secure random bytes can be had without the library's slow CPU-spinning collection.
+// Each source's raw samples get continuous repetition-count and adaptive-proportion health tests,
+// and only samples from a source currently passing both are credited.
+// Output is only taken through AES-128 keyed by the pool.
+// It is empty at boot, so start-up (eg ensureIDCreated()) still uses OTV0P2BASE::getSecureRandomByte().
+enum { ENTROPY_SRC_JITTER, ENTROPY_SRC_SENSOR, ENTROPY_SRC_RX, ENTROPY_SOURCES };
+// Mix in a raw sample from the given source with an estimate of its real entropy in bits [0,8].
+void entropyPoolAdd(uint8_t source, uint8_t sample, uint8_t estBits);
+// Get len [1,16] secure random bytes from the pool; false (buf untouched) if it lacks 8*len credited bits.
+bool entropyPoolGetBytes(uint8_t *buf, uint8_t len);
+// Replace the node ID (as for CLI "I *") from the pool; false (ID untouched) if it lacks enough entropy.
+bool entropyPoolResetID();
+#endif // defined(ENABLE_ENTROPY_POOL)
+
+
+/////// SKETCH-LOCAL EEPROM
+
+// Non-volatile records kept by this sketch rather than the library,
+// allocated upwards from just above the bulk stats area and clear of the node associations.
+// As for library records, an erased (0xff) byte means 'unset'.
+// Learned warm-up rate per start-temperature band, C16 per hour, 1 byte each.
+#define V0P2_EE_START_PREHEAT_RATE (V0P2BASE_EE_END_STATS + 1)
+#define V0P2_EE_LEN_PREHEAT_RATE 4
+// Weekly schedule slot bitmap, stored inverted so that erased EEPROM means no WARM slots.
+#define V0P2_EE_START_WEEKLY_SCHEDULE (V0P2_EE_START_PREHEAT_RATE + V0P2_EE_LEN_PREHEAT_RATE)
+#define V0P2_EE_LEN_WEEKLY_SCHEDULE 21
+// Days to add to the RTC-derived day of the week, [0,6]; unset (0xff) is treated as 0.
+#define V0P2_EE_START_WEEKLY_DOW_ADJUST (V0P2_EE_START_WEEKLY_SCHEDULE + V0P2_EE_LEN_WEEKLY_SCHEDULE)
+// Direct-drive valve fitted state byte followed by its CRC (crc7_5B, non-zero) for ENABLE_VALVE_FITTED_CACHE.
+#define V0P2_EE_START_VALVE_FITTED (V0P2_EE_START_WEEKLY_DOW_ADJUST + 1)
+#define V0P2_EE_LEN_VALVE_FITTED 2
+// INCLUSIVE END OF SKETCH-LOCAL AREA: must point to last byte used.
+#define V0P2_EE_END_SKETCH (V0P2_EE_START_VALVE_FITTED + V0P2_EE_LEN_VALVE_FITTED - 1)
+static_assert(V0P2_EE_END_SKETCH < V0P2BASE_EE_START_NODE_ASSOCIATIONS_WORK_START, "sketch EEPROM overlaps node associations");
+
 
 /////// STATS
 
@@ -474,6 +891,30 @@ void bareStatsTX(bool allowDoubleTX = false, bool doBinary = false);
 void remoteCallForHeatRX(uint16_t id, uint8_t percentOpen);
 #endif
 
+// IF DEFINED: hub-coordinated (TDMA-style) stats TX slot allocation, eg for large installs.
+// The hub lists the leading ID bytes of its associated nodes in the body of its secure beacon,
+// and the position of a node's ID in that list is its stats TX slot (one of 8, seconds 8--22).
+// Leaf nodes track the offset of their minute from the hub's (without moving the RTC)
+// and TX in the local minor cycle overlapping the allocated slot,
+// falling back to randomised slots whenever no beacon has been heard for a while.
+// A leaf must be able to RX (with a radio IRQ line) and have the hub's ID associated.
+#if defined(ENABLE_TX_SLOT_ALLOCATION)
+#if !defined(ENABLE_OTSECUREFRAME_ENCODING_SUPPORT)
+#error ENABLE_TX_SLOT_ALLOCATION requires ENABLE_OTSECUREFRAME_ENCODING_SUPPORT
+#endif
+// Number of leading node ID bytes in each beacon slot entry.
+static constexpr uint8_t TX_SLOT_ID_PREFIX_BYTES = 2;
+// Maximum number of slots that can be allocated: one per minor cycle from second 8 to 22.
+static constexpr uint8_t TX_SLOT_MAX_SLOTS = 8;
+// Second (in the hub's minute) at which the hub beacon is sent.
+static constexpr uint8_t TX_SLOT_BEACON_SECOND = 30;
+// Called with the slot allocated to this node by an authenticated hub beacon
+// and the local second and sub-cycle time at which the beacon was picked up.
+// Records the offset of this node's minute phase from the hub's.
+// Not thread-/ISR- safe.
+void txSlotAllocationRX(uint8_t slot, uint8_t rxSeconds, uint8_t rxSCT);
+#endif // defined(ENABLE_TX_SLOT_ALLOCATION)
+
 ////// UI
 
 // Valve physical UI controller.
@@ -526,6 +967,9 @@ static constexpr bool binaryOnlyValveControl = true;
 typedef OTRadValve::ValveMotorDirectV1<m1, m2, MOTOR_DRIVE_MI_AIN, MOTOR_DRIVE_MC_AIN, decltype(Supply_cV), &Supply_cV, binaryOnlyValveControl> ValveDirect_t;
 extern ValveDirect_t ValveDirect;
 #endif
+#if defined(ENABLE_VALVE_FITTED_CACHE) && !(defined(HAS_DORM1_VALVE_DRIVE) && defined(ENABLE_LOCAL_TRV))
+#error ENABLE_VALVE_FITTED_CACHE needs ENABLE_V1_DIRECT_MOTOR_DRIVE and ENABLE_LOCAL_TRV
+#endif
 
 // Singleton FHT8V valve instance (to control remote FHT8V valve by radio).
 #ifdef ENABLE_FHT8VSIMPLE
@@ -85,6 +85,7 @@ void panic(const __FlashStringHelper *s)
 //     The value of n is 1, 2, 3, 4, 5.
 //   * The LED should then go off except for optional faint flickers as the radio is being driven if set up to do so.
 #define PP_OFF_MS 250
+#if !defined(ENABLE_FAST_BOOT)
 static void posPOST(const uint8_t position, const __FlashStringHelper *s = NULL)
   {
   OTV0P2BASE::sleepLowPowerMs(1000);
@@ -120,6 +121,7 @@ static void posPOST(const uint8_t position, const __FlashStringHelper *s = NULL)
   OTV0P2BASE::LED_HEATCALL_ON();
   OTV0P2BASE::sleepLowPowerMs(1000); // TODO: use this time to gather entropy.
   }
+#endif // !defined(ENABLE_FAST_BOOT)
 
 
 // Pick an appropriate radio config for RFM23 (if it is the primary radio).
@@ -209,6 +211,11 @@ static bool FilterRXISR(const volatile uint8_t *buf, volatile uint8_t &buflen)
 #define FilterRXISR NULL
 #endif
 
+#if defined(ENABLE_BOOT_TIME_STAT)
+// RTC seconds and sub-cycle time at which boot timing started, once the xtal is checked.
+static uint8_t bootS0, bootSCT0;
+#endif // defined(ENABLE_BOOT_TIME_STAT)
+
 void optionalPOST()
   {
   // Have 32678Hz clock at least running before going any further.
@@ -225,8 +232,25 @@ void optionalPOST()
   DEBUG_SERIAL_PRINTLN_FLASHSTRING("(No xtal.)");
 #endif // defined(ENABLE_WAKEUP_32768HZ_XTAL)
 
+#if defined(ENABLE_BOOT_TIME_STAT)
+  // Start timing only once the RTC is known to be running,
+  // so bT excludes the reset-to-here work including the xtal check/calibration itself.
+  bootS0 = OTV0P2BASE::getSecondsLT();
+  bootSCT0 = OTV0P2BASE::getSubCycleTime();
+#endif
+
+#if defined(ENABLE_FAST_BOOT)
+  // Fast boot keeps the xtal check/calibration above and the radio set-up below on the critical path:
+  // everything timed by the RTC (and the tuned CPU clock for serial/radio) depends on the former,
+  // the radio draws a lot of power until initialised, and a failure of either must panic before running.
+  // Signal that xtal is running with a brief blink, and give it a little time to settle.
+  OTV0P2BASE::LED_HEATCALL_OFF();
+  OTV0P2BASE::sleepLowPowerMs(PP_OFF_MS);
+  OTV0P2BASE::LED_HEATCALL_ON();
+#else
   // Signal that xtal is running AND give it time to settle.
   posPOST(0 /*, F("about to test radio module") */);
+#endif
 
 // FIXME  This section needs refactoring
 #ifdef ENABLE_RADIO_PRIMARY_RFM23B
@@ -292,6 +316,11 @@ void optionalPOST()
 #endif
 #endif // Select user-facing boards.
 
+#if defined(ENABLE_MOULD_RISK_MODE) && defined(DEBUG)
+  // Check the fixed-point dew point maths against its reference vectors.
+  if(!dewPointC16SelfTest()) { panic(F("dp")); }
+#endif
+
 // Save space (and time) by avoiding the second POST sequence; LED will be turned off anyway.
 //  // Single/main POST checkpoint for speed.
 //  posPOST(1 /* , F("POST OK") */ );
@@ -315,6 +344,15 @@ AmbientLight AmbLight;
 OTV0P2BASE::MinimalOneWire<> MinOW_DEFAULT;
 #endif
 
+#if defined(ENABLE_DS18B20_BUS)
+#if defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
+// Slightly reduced precision to improve speed, as for the single primary sensor.
+DS18B20Bus ds18b20Bus(MinOW_DEFAULT, OTV0P2BASE::TemperatureC16_DS18B20::MAX_PRECISION - 1);
+#else
+DS18B20Bus ds18b20Bus(MinOW_DEFAULT, OTV0P2BASE::TemperatureC16_DS18B20::MAX_PRECISION);
+#endif
+#endif
+
 #if defined(SENSOR_EXTERNAL_DS18B20_ENABLE_0) // Enable sensor zero.
 OTV0P2BASE::TemperatureC16_DS18B20 extDS18B20_0(MinOW_DEFAULT, 0);
 #endif
@@ -327,8 +365,16 @@ OTV0P2BASE::DummyHumiditySensorSHT21 RelHumidity;
 #endif
 
 // Ambient/room temperature sensor, usually on main board.
-#if defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
+#if defined(ENABLE_SIMULATED_ROOM)
+SimulatedRoomTemperatureC16 TemperatureC16; // Simulated room for closed-loop testing.
+#elif defined(TEMP_SENSOR_I2C_ASYNC) && defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
+AsyncRoomTemperatureC16_SHT21 TemperatureC16; // SHT21 impl, split-phase.
+#elif defined(TEMP_SENSOR_I2C_ASYNC)
+AsyncRoomTemperatureC16_TMP112 TemperatureC16; // TMP112 impl, split-phase.
+#elif defined(ENABLE_PRIMARY_TEMP_SENSOR_SHT21)
 OTV0P2BASE::RoomTemperatureC16_SHT21 TemperatureC16; // SHT21 impl.
+#elif defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20) && defined(ENABLE_DS18B20_BUS)
+DS18B20BusTemperatureC16 TemperatureC16; // Probe 0 of the shared bus.
 #elif defined(ENABLE_PRIMARY_TEMP_SENSOR_DS18B20)
 #if defined(ENABLE_MINIMAL_ONEWIRE_SUPPORT)
 // DSB18B20 temperature impl, with slightly reduced precision to improve speed.
@@ -426,6 +472,19 @@ StatsLine_t statsLine;
 // SETUP
 //========================================
 
+#if defined(ENABLE_BOOT_TIME_STAT)
+uint16_t bootTimeMs;
+// Elapsed ms by the RTC since the given seconds and sub-cycle time, assuming less than a minute.
+static uint16_t rtcMsSince(const uint8_t s0, const uint8_t sct0)
+  {
+  const uint8_t s1 = OTV0P2BASE::getSecondsLT();
+  const uint8_t sct1 = OTV0P2BASE::getSubCycleTime();
+  const uint8_t minorCycles = ((s1/2) + 30 - (s0/2)) % 30;
+  const int32_t ticks = ((int32_t)minorCycles * (OTV0P2BASE::GSCT_MAX+1)) + sct1 - sct0;
+  return((ticks <= 0) ? 0 : (uint16_t)((ticks * 125) / 16)); // 2000ms per GSCT_MAX+1 ticks.
+  }
+#endif // defined(ENABLE_BOOT_TIME_STAT)
+
 // Setup routine: runs once after reset.
 // Does some limited board self-test and will panic() if anything is obviously broken.
 void setup()
@@ -506,7 +565,9 @@ void setup()
   DEBUG_SERIAL_PRINT(heat);
   DEBUG_SERIAL_PRINTLN();
 #endif
-#if defined(ENABLE_AMBLIGHT_SENSOR)
+  // With a fast boot leave sensors not needed for the first valve computation to the main loop,
+  // except light when the valve-fitted shortcut needs it at once for its dark-room deferral.
+#if defined(ENABLE_AMBLIGHT_SENSOR) && (!defined(ENABLE_FAST_BOOT) || defined(ENABLE_VALVE_FITTED_CACHE))
   const int light = AmbLight.read();
 #if 0 && defined(DEBUG) && !defined(ENABLE_TRIMMED_MEMORY)
   DEBUG_SERIAL_PRINT_FLASHSTRING("L: ");
@@ -514,7 +575,7 @@ void setup()
   DEBUG_SERIAL_PRINTLN();
 #endif
 #endif
-#if defined(HUMIDITY_SENSOR_SUPPORT)
+#if defined(HUMIDITY_SENSOR_SUPPORT) && !defined(ENABLE_FAST_BOOT)
   const uint8_t rh = RelHumidity.read();
 #if 0 && defined(DEBUG) && !defined(ENABLE_TRIMMED_MEMORY)
   DEBUG_SERIAL_PRINT_FLASHSTRING("RH%: ");
@@ -548,6 +609,8 @@ void setup()
   DEBUG_SERIAL_PRINTLN();
 #endif
 #if !defined(ENABLE_MIN_ENERGY_BOOT)
+  // Kept even for a fast boot: it must sweep SRAM before use overwrites its uninitialised state,
+  // and ID creation and setupOpenTRV() draw on the seeded generators.
   OTV0P2BASE::seedPRNGs();
 #endif
 
@@ -558,8 +621,12 @@ void setup()
   // Update targets, output to TRV and boiler, etc, to be sensible before main loop starts.
   NominalRadValve.read();
 #endif
+#if defined(ENABLE_BOOT_TIME_STAT)
+  bootTimeMs = rtcMsSince(bootS0, bootSCT0);
+#endif
 
   // Ensure that the unique node ID is set up (mainly on first use).
+  // Kept in setup() as stats and secure frames need the ID from the first loop; it only reads EEPROM once set.
   // Have one attempt (don't want to stress an already failing EEPROM) to force-reset if not good, then panic.
   // Needs to have had entropy gathered, etc.
   if(!OTV0P2BASE::ensureIDCreated())
@@ -576,8 +643,9 @@ void setup()
   OTV0P2BASE::serialPrintlnAndFlush(F("At CLI > prompt enter ? for help"));
 #endif
 
-#if !defined(ENABLE_TRIMMED_MEMORY)
+#if !defined(ENABLE_TRIMMED_MEMORY) && !defined(ENABLE_FAST_BOOT)
   // Report initial status.
+  // (With a fast boot the main loop's once-a-minute report stands in, avoiding slow serial output here.)
   serialStatusReport();
 #endif
   // Do OpenTRV-specific (late) setup.